@@ -0,0 +1,60 @@
+// **********************************************************************************
+// Redundant bursts for show critical broadcast cues
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// A burst sends one numbered cue `copies` times, spacingMs apart with up to
+// BURST_JITTER_MS of random jitter so a periodic interferer can't take out every
+// copy. All copies aim at the same fire time, just after the last copy is due:
+// each carries copiesLeft and the ms still to go, and hats dedupe on the cue's seq.
+//
+// The cue is encoded once when the burst starts, and each copy fills copiesLeft and
+// the ms to go into that frame as it is handed to the TX queue, so CSMA and queueing
+// delays land in the fire time error (a few ms at most with the channel clear).
+// Hats synced by SyncBeacon use the cue's atMicros instead, which has no such error.
+// **********************************************************************************
+#ifndef CueBurst_h
+#define CueBurst_h
+#include <Arduino.h>
+#include <AntlerProtocol.h>
+
+#define BURST_COPIES      3   // default copies per burst
+#define BURST_SPACING_MS  10  // default nominal gap between copies
+#define BURST_JITTER_MS   3   // each copy goes up to this much early or late
+#define BURST_MAX_COPIES  8
+#define BURST_SLOTS       2   // bursts that can overlap
+
+class CueBurst {
+  public:
+    CueBurst() : copies(BURST_COPIES), spacingMs(BURST_SPACING_MS) { memset(_slots, 0, sizeof(_slots)); }
+
+    // Starts a burst of a numbered cue and sets its atMicros to the fire time,
+    // false when all slots are busy
+    bool start(ToAntlersPayload& cue, uint8_t node);
+
+    // Copies the next copy that has come due into frame and sets node,
+    // returns its length or 0 if none is due
+    uint8_t due(uint8_t* frame, uint8_t& node);
+
+    // Applies to bursts started afterwards; (copies-1) * spacingMs + jitter must stay below 255ms
+    bool configure(uint8_t newCopies, uint8_t newSpacingMs);
+
+    uint8_t copies;
+    uint8_t spacingMs;
+
+  private:
+    struct Slot {
+      uint8_t frame[ANTLER_CUE_MAX_LEN]; // always with the ANTLER_CUE_BURST fields
+      uint8_t len;
+      uint8_t node;
+      uint8_t left;     // copies not yet sent, 0 = slot free
+      uint8_t spacingMs;
+      uint32_t nextMs;  // when the next copy is due
+      uint32_t fireMs;  // when hats act on it
+    };
+
+    Slot _slots[BURST_SLOTS];
+};
+
+#endif
@@ -0,0 +1,52 @@
+// **********************************************************************************
+// Recently broadcast cues, kept so hats that missed one can be sent just that cue
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// Every broadcast cue gets the next sequence number, from 0 at startup, and its encoded
+// frame is kept here. Hats report the newest seq they heard and which of the 8 before it they
+// missed (see AntlerProtocol.h); nextMissing() walks the kept cues that a report
+// shows missing, oldest first, so the sketch can re-send them to that hat alone.
+// A hat further behind than CUE_HISTORY_LEN cues only gets the ones still kept.
+// Cues younger than CUE_REPAIR_HOLDOFF_MS are never repaired: telemetry sent before
+// the cue went out is still arriving, and the hats that heard it are replying.
+// **********************************************************************************
+#ifndef CueHistory_h
+#define CueHistory_h
+#include <Arduino.h>
+#include <AntlerProtocol.h>
+
+#ifndef CUE_HISTORY_LEN
+  #define CUE_HISTORY_LEN 4
+#endif
+#define CUE_REPAIR_HOLDOFF_MS 200
+
+class CueHistory {
+  public:
+    CueHistory() : _next(0), _count(0) {}
+
+    // Numbers a broadcast cue: sets cue.seq/seqUse for encoding, then call add()
+    void number(ToAntlersPayload& cue) { cue.seq = _next++; cue.seqUse = true; }
+    void add(uint8_t seq, const uint8_t* frame, uint8_t len);
+
+    // Returns the position to continue from and points frame/len at the next kept cue
+    // the telemetry shows missing, or returns 0 once there are none left. Start at 0.
+    uint8_t nextMissing(const ToControllersPayload& telemetry, uint8_t from, const uint8_t*& frame, uint8_t& len);
+
+  private:
+    struct Entry {
+      uint8_t seq;
+      uint8_t len;
+      uint16_t sentMs; // low bits of millis()
+      uint8_t frame[ANTLER_CUE_MAX_LEN];
+    };
+
+    bool missing(const ToControllersPayload& telemetry, uint8_t seq) const;
+
+    Entry _entries[CUE_HISTORY_LEN]; // oldest first
+    uint8_t _next;                   // seq of the next broadcast
+    uint8_t _count;
+};
+
+#endif
@@ -0,0 +1,90 @@
+// **********************************************************************************
+// Fleet polling: ask every hat in a range for its status, several at a time
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// A sweep walks nodes firstNode to firstNode+nodes-1 in turn and sends each an
+// ANTLER_MSG_STATUS request, see AntlerProtocol.h. Up to window requests are
+// outstanding at once, each with its own timeoutMs deadline, so a slow or missing hat
+// holds up only its own entry instead of the whole walk. The telemetry it answers
+// with goes into the fleet table like any other.
+//
+// A hat that times out is asked again in a later pass over the range, after everyone
+// else, up to POLLER_PASSES requests per sweep; one that answers late still counts.
+// Hats heard from during the sweep, asked or not, are not asked again.
+//
+// finished() reports each sweep once it is over: the nodes, how many answered, the
+// timeouts and the time from the sweep starting to the last answer or timeout.
+//
+// Requests go out on the cue radio. With one radio the answers come back on the same
+// channel and contend with the next requests, so with every hat present a window of 1
+// is quickest; a window of 2-4 pays off once hats are missing, as their timeouts then
+// overlap instead of adding up. With DUAL_RADIO the answers have a channel of their own
+// and a window of 4 about halves the sweep either way.
+// **********************************************************************************
+#ifndef FleetPoller_h
+#define FleetPoller_h
+#include <Arduino.h>
+
+#define POLLER_WINDOW_MAX     8   // outstanding requests
+#define POLLER_PASSES         3   // requests to a hat per sweep before it counts as missing
+#define POLLER_MIN_TIMEOUT_MS 10
+#define POLLER_MIN_PERIOD_MS  100
+
+class FleetPoller {
+  public:
+    FleetPoller();
+
+    // Sweeps of nodes nodes from firstNode, every periodMs or just once with 0. nodes 0
+    // stops polling. False if window or timeoutMs are out of range, or the range takes in
+    // node 0, the broadcast address.
+    bool configure(uint8_t firstNode, uint8_t nodes, uint8_t window, uint8_t timeoutMs, uint16_t periodMs);
+
+    // Expires overdue requests and moves the sweep on, call it from loop()
+    void tick();
+
+    // The next hat to send a request to, if the window has room. Its timeout runs from now.
+    bool next(uint8_t& node);
+
+    // Telemetry from nodeId arrived
+    void heard(uint8_t nodeId);
+
+    bool sweeping() const { return _sweeping; }
+
+    // True once per sweep when it is over
+    bool finished(uint8_t& nodes, uint8_t& answered, uint16_t& timeouts, uint32_t& sweepUs);
+
+  private:
+    struct Request {
+      uint8_t node;
+      uint32_t sentMs;
+    };
+
+    static bool bit(const uint8_t* bits, uint8_t n) { return bits[n >> 3] & (1 << (n & 7)); }
+    static void setBit(uint8_t* bits, uint8_t n, bool on);
+    void drop(uint8_t i); // remove outstanding request i
+
+    uint8_t _firstNode;
+    uint8_t _nodes;
+    uint8_t _window;
+    uint8_t _timeoutMs;
+    uint16_t _periodMs;
+    bool _repeat;
+    uint32_t _nextMs;     // millis() the next sweep is due
+
+    bool _sweeping;
+    bool _finished;       // a sweep is over and not yet reported
+    uint8_t _pass;
+    uint16_t _cursor;     // offset of the next node in this pass, _nodes at its end
+    uint32_t _startMicros;
+    uint32_t _sweepUs;
+    uint8_t _answered;
+    uint16_t _timeouts;
+    Request _out[POLLER_WINDOW_MAX];
+    uint8_t _outCount;
+    uint8_t _done[32];    // bit n = node n answered in this sweep
+    uint8_t _retry[32];   // bit n = node n timed out in this pass, ask again in the next
+};
+
+#endif
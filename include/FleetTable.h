@@ -0,0 +1,74 @@
+// **********************************************************************************
+// Last telemetry heard from every antler hat, kept on the controller for the host to poll
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// One byte per field per node, indexed by node ID, so 255 nodes cost 5 bytes each plus
+// a changed bit (~1.3K); env:moteino caps FLEET_MAX_NODES at 100 (~0.5K) to leave the
+// 328P room for everything else. Packets from node IDs beyond the table are not stored;
+// update() returns false for them and the next dump's last frame says so
+// (SERIAL_FLEET_UNTRACKED). The fields are stored coarsely:
+//
+//   state        as received
+//   link         bit 7 antlerState, bits 0-6 -RSSI in dBm (clamped to 127)
+//   vcc          20mV steps (0-5.10V), 0 = never heard from
+//   temperature  degrees C, as received
+//   seen         bits 4-7 packet counter (wraps at 16), bits 0-3 seconds since the
+//                last packet (stops at 15)
+//
+// A dump record is node(1) followed by those five bytes, see SERIAL_RSP_FLEET.
+// **********************************************************************************
+#ifndef FleetTable_h
+#define FleetTable_h
+#include <Arduino.h>
+#include <AntlerProtocol.h>
+
+#ifndef FLEET_MAX_NODES
+  #define FLEET_MAX_NODES   255 // node IDs 0 to FLEET_MAX_NODES-1 are tracked
+#endif
+#define FLEET_RECORD_LEN    6   // node + state + link + vcc + temperature + seen
+#define FLEET_AGE_MAX       15
+#define FLEET_AGE_PERIOD_MS 1000
+
+class FleetTable {
+  public:
+    FleetTable();
+
+    // Record a telemetry packet; rssi is the reception RSSI of the frame. Returns false,
+    // and stores nothing, for a node ID beyond the table
+    bool update(const ToControllersPayload& payload, int16_t rssi);
+
+    // Ages every entry once per FLEET_AGE_PERIOD_MS, call it from loop()
+    void tick();
+
+    bool known(uint8_t nodeId) const { return nodeId < FLEET_MAX_NODES && _vcc[nodeId] != 0; }
+
+    // Dump in progress: startDump(), then nextRecords() until it returns false
+    void startDump(bool changedOnly);
+    bool dumping() const { return _dumpNext < FLEET_MAX_NODES; }
+
+    // Writes up to max FLEET_RECORD_LEN records to out and clears their changed bits.
+    // Sets count to the records written, returns true while more nodes remain.
+    bool nextRecords(uint8_t* out, uint8_t max, uint8_t& count);
+
+    // True once after update() has turned a node away, for the last frame of a dump
+    bool untracked();
+
+  private:
+    bool changed(uint8_t nodeId) const { return _changed[nodeId >> 3] & (1 << (nodeId & 7)); }
+
+    uint8_t _state[FLEET_MAX_NODES];
+    uint8_t _link[FLEET_MAX_NODES];
+    uint8_t _vcc[FLEET_MAX_NODES];
+    int8_t _temperature[FLEET_MAX_NODES];
+    uint8_t _seen[FLEET_MAX_NODES];
+    uint8_t _changed[(FLEET_MAX_NODES + 7) / 8];
+
+    uint32_t _agedMs;     // millis() of the last tick
+    uint16_t _dumpNext;   // next node to dump, FLEET_MAX_NODES when idle
+    bool _dumpChanged;    // dump only the nodes heard from since their last dump
+    bool _untracked;      // a node beyond the table was heard since untracked() was last true
+};
+
+#endif
@@ -0,0 +1,60 @@
+// **********************************************************************************
+// Latency histograms for the sections of the controller's loop()
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// Each section worth watching (PROFILE_*) gets the count, the exact maximum and a
+// histogram of its run times from micros(). Buckets are log2: bucket 0 is under 4us
+// (one micros() tick on a 16MHz AVR), bucket n covers 2^(n+1) up to 2^(n+2) us and the
+// last one is open ended. p99Us() is the top of the bucket holding the 99th percentile,
+// so within a factor of two, which is plenty to tell which path adds cue latency.
+// Bucket counts stop at 65535.
+//
+// A ProfileScope times the block it is declared in, early returns included.
+// The host reads the sections with SERIAL_CMD_LOOP_STATS, see SerialLink.h.
+// **********************************************************************************
+#ifndef LoopProfiler_h
+#define LoopProfiler_h
+#include <Arduino.h>
+
+#define PROFILE_LOOP      0 // loop() start to start
+#define PROFILE_RECEIVE   1 // receiveFrame(), per radio frame
+#define PROFILE_SERIAL    2 // reading and handling host command bytes, when there were any
+#define PROFILE_PAYLOAD   3 // sendAntlerPayload()
+#define PROFILE_OTA       4 // CheckForWirelessHEX()
+#define PROFILE_SECTIONS  5
+#define PROFILE_BUCKETS   16
+
+class LoopProfiler {
+  public:
+    LoopProfiler();
+
+    void record(uint8_t section, uint32_t us);
+    void reset(uint8_t section);
+
+    uint32_t count(uint8_t section) const { return _count[section]; }
+    uint32_t maxUs(uint8_t section) const { return _max[section]; }
+    uint32_t p99Us(uint8_t section) const;
+    uint16_t bucket(uint8_t section, uint8_t i) const { return _buckets[section][i]; }
+
+    static uint8_t bucketOf(uint32_t us);
+
+  private:
+    uint16_t _buckets[PROFILE_SECTIONS][PROFILE_BUCKETS];
+    uint32_t _count[PROFILE_SECTIONS];
+    uint32_t _max[PROFILE_SECTIONS];
+};
+
+class ProfileScope {
+  public:
+    ProfileScope(LoopProfiler& profiler, uint8_t section) : _profiler(profiler), _section(section), _start(micros()) {}
+    ~ProfileScope() { _profiler.record(_section, micros() - _start); }
+
+  private:
+    LoopProfiler& _profiler;
+    uint8_t _section;
+    uint32_t _start;
+};
+
+#endif
@@ -0,0 +1,53 @@
+// **********************************************************************************
+// Airtime every antler hat's frames took, kept on the controller for the host to poll
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// Counts the on-air time (RFM69::airtimeUs()) of each frame heard from a node, per
+// NODE_AIRTIME_PERIOD_MS. One byte per node for the period in progress and one for the
+// last whole period, in NODE_AIRTIME_UNIT_US steps, so 255 nodes cost ~510 bytes.
+// A count stops at 255, ~6.5% of the channel for a single hat. It covers the same node
+// IDs as FleetTable.h; the fleet dump reports any node beyond them.
+//
+// A dump record is node(1) airtime(1) of the last whole period, only for nodes that
+// were heard in it, see SERIAL_RSP_AIRTIME.
+// **********************************************************************************
+#ifndef NodeAirtime_h
+#define NodeAirtime_h
+#include <Arduino.h>
+#include "FleetTable.h"
+
+#define NODE_AIRTIME_UNIT_US     256
+#define NODE_AIRTIME_PERIOD_MS   1000 // RF69_AIRTIME_PERIOD_MS, so the totals and the nodes add up
+#define NODE_AIRTIME_RECORD_LEN  2    // node + airtime
+
+class NodeAirtime {
+  public:
+    NodeAirtime();
+
+    // Count one frame heard from nodeId
+    void add(uint16_t nodeId, uint32_t airtimeUs);
+
+    // Starts a new period once NODE_AIRTIME_PERIOD_MS is up, call it from loop()
+    void tick();
+
+    // In NODE_AIRTIME_UNIT_US, during the last whole period
+    uint8_t last(uint8_t nodeId) const { return nodeId < FLEET_MAX_NODES ? _last[nodeId] : 0; }
+
+    // Dump in progress: startDump(), then nextRecords() until it returns false
+    void startDump() { _dumpNext = 0; }
+    bool dumping() const { return _dumpNext < FLEET_MAX_NODES; }
+
+    // Writes up to max NODE_AIRTIME_RECORD_LEN records to out. Sets count to the records
+    // written, returns true while more nodes remain.
+    bool nextRecords(uint8_t* out, uint8_t max, uint8_t& count);
+
+  private:
+    uint8_t _current[FLEET_MAX_NODES];
+    uint8_t _last[FLEET_MAX_NODES];
+    uint32_t _periodStart; // millis() the current period began
+    uint16_t _dumpNext;    // next node to dump, FLEET_MAX_NODES when idle
+};
+
+#endif
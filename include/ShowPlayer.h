@@ -0,0 +1,60 @@
+// **********************************************************************************
+// Cue list stored in the controller's SPI flash and played back from millis()
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// The show lives in its own 64K block, well clear of the OTA image at 0x000000:
+//
+//   SHOW_FLASH_ADDR       "SHOW" count(2)
+//   SHOW_FLASH_ADDR + 16  record 0, record 1, ...
+//
+// A record is atMs(4) followed by the SERIAL_CMD_CUE body node(1) state(1) flags(1)
+// sleepTime(4), little endian, exactly as the host sends it in SERIAL_CMD_SHOW_CUE.
+// Records must be in ascending atMs order. Only the next record is kept in RAM.
+// **********************************************************************************
+#ifndef ShowPlayer_h
+#define ShowPlayer_h
+#include <Arduino.h>
+#include <SPIFlash.h>
+
+#define SHOW_FLASH_ADDR   0x40000UL // 256K into the 4Mbit W25X40CL
+#define SHOW_FLASH_SIZE   0x10000UL // one 64K erase block
+#define SHOW_HEADER_LEN   16
+#define SHOW_RECORD_LEN   11        // atMs + node + state + flags + sleepTime
+#define SHOW_MAX_CUES     ((SHOW_FLASH_SIZE - SHOW_HEADER_LEN) / SHOW_RECORD_LEN)
+
+class ShowPlayer {
+  public:
+    ShowPlayer(SPIFlash& flash) : _flash(flash), _count(0), _position(0), _startMs(0), _playing(false), _fetched(false) {}
+
+    // loading, in this order: erase(), store() each cue, commit()
+    void erase();
+    bool store(uint16_t index, const uint8_t* record);
+    bool commit(uint16_t count);
+
+    uint16_t load();                // reads the header, returns the number of cues (0 = no show)
+    bool start(uint32_t fromMs);    // plays from fromMs into the show, skipping earlier cues
+    void stop() { _playing = false; }
+
+    // Returns the next record once its time has come, NULL otherwise. Call it from loop()
+    // until it returns NULL so cues sharing a timestamp go out back to back.
+    const uint8_t* due();
+
+    bool playing() const { return _playing; }
+    uint16_t count() const { return _count; }
+    uint16_t position() const { return _position; }
+
+  private:
+    uint32_t recordAddr(uint16_t index) const { return SHOW_FLASH_ADDR + SHOW_HEADER_LEN + (uint32_t)index * SHOW_RECORD_LEN; }
+
+    SPIFlash& _flash;
+    uint16_t _count;
+    uint16_t _position;             // index of the record in _next
+    uint32_t _startMs;              // millis() at show time 0
+    bool _playing;
+    bool _fetched;                  // _next holds record _position
+    uint8_t _next[SHOW_RECORD_LEN];
+};
+
+#endif
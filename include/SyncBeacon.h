@@ -0,0 +1,75 @@
+// **********************************************************************************
+// Time sync beacons, so hats can act on broadcast cues at the same instant
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// Every SYNC_INTERVAL_MS a numbered ANTLER_MSG_SYNC beacon is broadcast with the
+// micros() at which the previous one finished transmitting, as reported by the
+// radio's txStamp() (see AntlerProtocol.h for how hats use it). A beacon that never
+// went out, or whose stamp isn't in yet, just means the next one carries no time.
+// The sketch only asks for a beacon with the TX queue empty, after reading txStamp(),
+// so the stamp it hands to sent() is always the previous beacon's.
+//
+// A radio profile switch is announced on every beacon until its time, with beacons
+// SYNC_SWITCH_SPEEDUP times as often meanwhile, see AntlerProtocol.h.
+//
+// With a second radio for telemetry, beacons also move the hats' telemetry onto its
+// channel, see ANTLER_SYNC_TELEMETRY.
+//
+// Broadcast cues are then scheduled SYNC_LEAD_MS ahead, time enough for CSMA and
+// the frame itself, so every hat that gets the cue first time acts at once.
+// **********************************************************************************
+#ifndef SyncBeacon_h
+#define SyncBeacon_h
+#include <Arduino.h>
+#include <AntlerProtocol.h>
+
+#ifndef SYNC_INTERVAL_MS
+  #define SYNC_INTERVAL_MS 1000
+#endif
+#ifndef SYNC_LEAD_MS
+  #define SYNC_LEAD_MS     10
+#endif
+#define SYNC_SWITCH_SPEEDUP  4
+#define SYNC_SWITCH_MIN_MS   1000 // announce a switch for at least this long
+
+class SyncBeacon {
+  public:
+    SyncBeacon() : _nextMs(0), _seq(0), _sentMicros(0), _sentSeq(0), _sentUse(false),
+                   _switchProfile(0), _switchMicros(0), _switchUse(false), _telemetryUse(false) {}
+
+    // Encodes a beacon into frame when one is due, returns its length or 0.
+    // Queue it with the radio's stamp flag set.
+    uint8_t due(uint8_t* frame);
+
+    // The last beacon from due() finished transmitting at txMicros
+    void sent(uint32_t txMicros);
+
+    // Announces a switch of the whole network to profile afterMs from now, false if
+    // afterMs is below SYNC_SWITCH_MIN_MS or the profile doesn't exist
+    bool announceSwitch(uint8_t profile, uint16_t afterMs);
+    // Once the switch time has come: true with the profile to set the radio to, until
+    // switched() is called
+    bool switchDue(uint8_t& profile) const;
+    void switched() { _switchUse = false; }
+
+    // Tells hats, from the next beacon on, whether to report on ANTLER_TELEMETRY_FREQUENCY
+    void telemetryChannel(bool use) { _telemetryUse = use; }
+
+    // Sets cue.atMicros/atUse to act SYNC_LEAD_MS from now
+    void schedule(ToAntlersPayload& cue) const { cue.atMicros = micros() + SYNC_LEAD_MS * 1000UL; cue.atUse = true; }
+
+  private:
+    uint32_t _nextMs;
+    uint8_t _seq;         // next beacon
+    uint32_t _sentMicros; // when beacon _sentSeq went out
+    uint8_t _sentSeq;
+    bool _sentUse;
+    uint8_t _switchProfile;
+    uint32_t _switchMicros;
+    bool _switchUse;
+    bool _telemetryUse;
+};
+
+#endif
@@ -0,0 +1,74 @@
+// **********************************************************************************
+// Telemetry sweeps: poll beacons that give every hat its own reply slot
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// Once configured, an ANTLER_MSG_POLL beacon is broadcast every periodMs (or once) and
+// the hats answer in their slots, see AntlerProtocol.h. Each slot is the telemetry
+// frame's airtime at the current profile plus ANTLER_POLL_GUARD_US, so a sweep of n
+// slots takes ANTLER_POLL_START_US + n * slotUs from the moment the poll is sent.
+//
+// The sweep is timed from the poll's txStamp(). The sketch shares the stamp with the
+// sync beacon by only queueing either one with the TX queue empty, and hands the poll's
+// to sent(); a poll that never went out is dropped with lost().
+//
+// Telemetry arriving during a sweep is counted once per node. When the last slot is
+// over, finished() reports the slots, the nodes that answered and the sweep time,
+// from the poll being due to the end of the last slot.
+//
+// With a single radio the slots are on the cue channel, so the sketch holds its other
+// frames (RFM69::txHold()) while sweeping() and cues wait up to a sweep. With
+// DUAL_RADIO the hats answer on the telemetry channel and cues are never held.
+//
+// Answers arrive a slot apart, quicker than the text output can print them, so sweeps
+// want SERIAL_OUTPUT_BINARY; in text mode the receive queue overflows and some are lost.
+// **********************************************************************************
+#ifndef TelemetryPoll_h
+#define TelemetryPoll_h
+#include <Arduino.h>
+#include <AntlerProtocol.h>
+
+#define POLL_MIN_PERIOD_MS 100 // sweeps never start closer together than this
+
+class TelemetryPoll {
+  public:
+    TelemetryPoll();
+
+    // Sweeps of slots slots, node firstNode in slot 0 (or the ANTLER_MSG_SLOT slots with
+    // assigned), every periodMs or just once with 0. slots 0 stops polling. False if
+    // periodMs is under POLL_MIN_PERIOD_MS.
+    bool configure(uint8_t firstNode, uint8_t slots, bool assigned, uint16_t periodMs);
+
+    // Encodes a poll with slots of slotUs into frame when one is due, returns its length
+    // or 0. Queue it with the radio's stamp flag set.
+    uint8_t due(uint8_t* frame, uint16_t slotUs);
+    // The poll from due() finished transmitting at txMicros, or never went out
+    void sent(uint32_t txMicros);
+    void lost();
+
+    // Is a poll waiting for sent()/lost(), or are its slots running?
+    bool queued() const { return _state == POLL_QUEUED; }
+    bool sweeping() const { return _state == POLL_SLOTS; }
+
+    // Telemetry from nodeId arrived
+    void heard(uint8_t nodeId);
+
+    // True once per sweep when its last slot is over
+    bool finished(uint8_t& slots, uint8_t& answered, uint32_t& sweepUs);
+
+  private:
+    enum { POLL_IDLE, POLL_QUEUED, POLL_SLOTS };
+
+    AntlerPollPayload _poll;
+    uint16_t _periodMs;
+    bool _repeat;
+    uint32_t _nextMs;      // millis() the next sweep is due
+    uint8_t _state;
+    uint32_t _dueMicros;   // micros() the current sweep was due
+    uint32_t _endMicros;   // and its last slot ends
+    uint8_t _answered;
+    uint8_t _heard[32];    // bit n = node n answered in this sweep
+};
+
+#endif
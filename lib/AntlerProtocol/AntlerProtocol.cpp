@@ -0,0 +1,410 @@
+// **********************************************************************************
+// Over-the-air payload codec, see AntlerProtocol.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "AntlerProtocol.h"
+
+#define ANTLER_HEADER(type) ((ANTLER_WIRE_VERSION << 4) | (type))
+
+static void putLong(uint8_t* out, uint32_t v) {
+  out[0] = v;
+  out[1] = v >> 8;
+  out[2] = v >> 16;
+  out[3] = v >> 24;
+}
+
+static uint32_t getLong(const uint8_t* data) {
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+uint8_t antlerMessageType(const uint8_t* data, uint8_t len) {
+  if (len == 0 || (data[0] >> 4) != ANTLER_WIRE_VERSION) return 0;
+  return data[0] & 0x0F;
+}
+
+// state(1) flags(1) and the optional fields, shared by ANTLER_MSG_CUE and ANTLER_MSG_ARM
+static uint8_t encodeCueBody(const ToAntlersPayload& cue, uint8_t* out) {
+  out[0] = cue.state;
+  out[1] = (cue.antlerState ? ANTLER_CUE_ANTLERSTATE : 0) |
+           (cue.antlerStateUse ? ANTLER_CUE_ANTLERSTATEUSE : 0) |
+           (cue.sleepTimeUse ? ANTLER_CUE_SLEEPTIMEUSE : 0) |
+           (cue.group ? ANTLER_CUE_GROUP : 0) |
+           (cue.seqUse ? ANTLER_CUE_SEQ : 0) |
+           (cue.atUse ? ANTLER_CUE_AT : 0);
+  bool burst = cue.copiesLeft || cue.fireInMs;
+  if (burst) out[1] |= ANTLER_CUE_BURST;
+  uint8_t len = 2;
+  if (cue.seqUse) out[len++] = cue.seq;
+  if (cue.group) out[len++] = cue.group;
+  if (burst) {
+    out[len++] = cue.copiesLeft;
+    out[len++] = cue.fireInMs;
+  }
+  if (cue.atUse) {
+    putLong(&out[len], cue.atMicros);
+    len += 4;
+  }
+  if (!cue.sleepTimeUse) return len;
+
+  uint32_t v = cue.sleepTime;
+  while (v >= 0x80) {
+    out[len++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  out[len++] = v;
+  return len;
+}
+
+static bool decodeCueBody(const uint8_t* data, uint8_t len, uint8_t senderId, ToAntlersPayload& cue) {
+  if (len < 2) return false;
+
+  uint8_t i = 2;
+  uint8_t seq = 0;
+  if (data[1] & ANTLER_CUE_SEQ) {
+    if (i >= len) return false;
+    seq = data[i++];
+  }
+  uint8_t group = 0;
+  if (data[1] & ANTLER_CUE_GROUP) {
+    if (i >= len) return false;
+    group = data[i++];
+  }
+  uint8_t copiesLeft = 0, fireInMs = 0;
+  if (data[1] & ANTLER_CUE_BURST) {
+    if (i + 2 > len) return false;
+    copiesLeft = data[i++];
+    fireInMs = data[i++];
+  }
+  uint32_t atMicros = 0;
+  if (data[1] & ANTLER_CUE_AT) {
+    if (i + 4 > len) return false;
+    atMicros = getLong(&data[i]);
+    i += 4;
+  }
+
+  uint32_t sleepTime = 0;
+  if (data[1] & ANTLER_CUE_SLEEPTIMEUSE) {
+    uint8_t start = i, shift = 0;
+    do {
+      if (i >= len || i >= start + ANTLER_VARINT_MAX) return false; // truncated or too long
+      sleepTime |= (uint32_t)(data[i] & 0x7F) << shift;
+      shift += 7;
+    } while (data[i++] & 0x80);
+  }
+  if (i != len) return false;
+
+  cue.nodeId = senderId;
+  cue.version = ANTLER_WIRE_VERSION;
+  cue.state = data[0];
+  cue.antlerState = data[1] & ANTLER_CUE_ANTLERSTATE;
+  cue.antlerStateUse = data[1] & ANTLER_CUE_ANTLERSTATEUSE;
+  cue.sleepTimeUse = data[1] & ANTLER_CUE_SLEEPTIMEUSE;
+  cue.sleepTime = sleepTime;
+  cue.group = group;
+  cue.seq = seq;
+  cue.seqUse = data[1] & ANTLER_CUE_SEQ;
+  cue.copiesLeft = copiesLeft;
+  cue.fireInMs = fireInMs;
+  cue.atMicros = atMicros;
+  cue.atUse = data[1] & ANTLER_CUE_AT;
+  return true;
+}
+
+uint8_t antlerEncodeCue(const ToAntlersPayload& cue, uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_CUE);
+  return 1 + encodeCueBody(cue, &out[1]);
+}
+
+bool antlerDecodeCue(const uint8_t* data, uint8_t len, uint8_t senderId, ToAntlersPayload& cue) {
+  if (antlerMessageType(data, len) != ANTLER_MSG_CUE) return false;
+  return decodeCueBody(&data[1], len - 1, senderId, cue);
+}
+
+uint8_t antlerEncodeArm(uint8_t slot, const ToAntlersPayload& cue, uint8_t* out) {
+  ToAntlersPayload armed = cue; // the GO frame is the timing, so no burst or atMicros
+  armed.copiesLeft = 0;
+  armed.fireInMs = 0;
+  armed.atUse = false;
+  out[0] = ANTLER_HEADER(ANTLER_MSG_ARM);
+  out[1] = slot;
+  return 2 + encodeCueBody(armed, &out[2]);
+}
+
+bool antlerDecodeArm(const uint8_t* data, uint8_t len, uint8_t senderId, uint8_t& slot, ToAntlersPayload& cue) {
+  if (len < 2 || antlerMessageType(data, len) != ANTLER_MSG_ARM || data[1] >= ANTLER_ARM_SLOTS) return false;
+  if (!decodeCueBody(&data[2], len - 2, senderId, cue)) return false;
+  slot = data[1];
+  return true;
+}
+
+uint8_t antlerEncodeGo(uint8_t slot, uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_GO);
+  out[1] = slot;
+  return ANTLER_GO_LEN;
+}
+
+bool antlerDecodeGo(const uint8_t* data, uint8_t len, uint8_t& slot) {
+  if (len != ANTLER_GO_LEN || antlerMessageType(data, len) != ANTLER_MSG_GO || data[1] >= ANTLER_ARM_SLOTS) return false;
+  slot = data[1];
+  return true;
+}
+
+uint8_t antlerEncodePoll(const AntlerPollPayload& poll, uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_POLL);
+  out[1] = poll.firstNode;
+  out[2] = poll.slots;
+  out[3] = poll.slotUs;
+  out[4] = poll.slotUs >> 8;
+  out[5] = poll.assigned ? ANTLER_POLL_ASSIGNED : 0;
+  return ANTLER_POLL_LEN;
+}
+
+bool antlerDecodePoll(const uint8_t* data, uint8_t len, AntlerPollPayload& poll) {
+  if (len != ANTLER_POLL_LEN || antlerMessageType(data, len) != ANTLER_MSG_POLL) return false;
+  poll.firstNode = data[1];
+  poll.slots = data[2];
+  poll.slotUs = (uint16_t)data[3] | ((uint16_t)data[4] << 8);
+  poll.assigned = data[5] & ANTLER_POLL_ASSIGNED;
+  return true;
+}
+
+uint8_t antlerEncodeSlot(uint8_t slot, uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_SLOT);
+  out[1] = slot;
+  return ANTLER_SLOT_LEN;
+}
+
+bool antlerDecodeSlot(const uint8_t* data, uint8_t len, uint8_t& slot) {
+  if (len != ANTLER_SLOT_LEN || antlerMessageType(data, len) != ANTLER_MSG_SLOT) return false;
+  slot = data[1];
+  return true;
+}
+
+uint8_t antlerEncodeStatus(uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_STATUS);
+  return ANTLER_STATUS_LEN;
+}
+
+bool antlerDecodeStatus(const uint8_t* data, uint8_t len) {
+  return len == ANTLER_STATUS_LEN && antlerMessageType(data, len) == ANTLER_MSG_STATUS;
+}
+
+uint8_t antlerEncodeTelemetry(const ToControllersPayload& telemetry, uint8_t* out) {
+  float mv = telemetry.vcc * 1000 + 0.5f;
+  out[0] = ANTLER_HEADER(ANTLER_MSG_TELEMETRY);
+  out[1] = telemetry.state;
+  out[2] = (telemetry.antlerState ? ANTLER_TELEMETRY_ANTLERSTATE : 0) |
+           (telemetry.cueSeqUse ? ANTLER_TELEMETRY_CUESEQ : 0);
+  uint16_t vcc = mv < 0 ? 0 : mv > 65535 ? 65535 : (uint16_t)mv;
+  out[3] = vcc;
+  out[4] = vcc >> 8;
+  out[5] = constrain(telemetry.temperature, -128, 127);
+  out[6] = telemetry.cueSeqUse ? telemetry.cueSeq : 0;
+  out[7] = telemetry.cueSeqUse ? telemetry.cueMissed : 0;
+  return ANTLER_TELEMETRY_LEN;
+}
+
+bool antlerDecodeTelemetry(const uint8_t* data, uint8_t len, uint8_t senderId, ToControllersPayload& telemetry) {
+  if (len != ANTLER_TELEMETRY_LEN || antlerMessageType(data, len) != ANTLER_MSG_TELEMETRY) return false;
+  telemetry.nodeId = senderId;
+  telemetry.version = ANTLER_WIRE_VERSION;
+  telemetry.state = data[1];
+  telemetry.antlerState = data[2] & ANTLER_TELEMETRY_ANTLERSTATE;
+  telemetry.vcc = ((uint16_t)data[3] | ((uint16_t)data[4] << 8)) / 1000.0f;
+  telemetry.temperature = (int8_t)data[5];
+  telemetry.cueSeq = data[6];
+  telemetry.cueMissed = data[7];
+  telemetry.cueSeqUse = data[2] & ANTLER_TELEMETRY_CUESEQ;
+  return true;
+}
+
+uint8_t antlerEncodeGroups(uint16_t groups, uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_GROUPS);
+  out[1] = groups;
+  out[2] = groups >> 8;
+  return ANTLER_GROUPS_LEN;
+}
+
+bool antlerDecodeGroups(const uint8_t* data, uint8_t len, uint16_t& groups) {
+  if (len != ANTLER_GROUPS_LEN || antlerMessageType(data, len) != ANTLER_MSG_GROUPS) return false;
+  groups = (uint16_t)data[1] | ((uint16_t)data[2] << 8);
+  return true;
+}
+
+uint8_t antlerEncodeSync(const AntlerSyncPayload& sync, uint8_t* out) {
+  out[0] = ANTLER_HEADER(ANTLER_MSG_SYNC);
+  out[1] = sync.seq;
+  out[2] = (sync.prevUse ? ANTLER_SYNC_PREV : 0) | (sync.switchUse ? ANTLER_SYNC_SWITCH : 0) |
+           (sync.telemetryUse ? ANTLER_SYNC_TELEMETRY : 0);
+  uint8_t len = 3;
+  if (sync.prevUse) {
+    putLong(&out[len], sync.prevMicros);
+    len += 4;
+  }
+  if (sync.switchUse) {
+    out[len++] = sync.profile;
+    putLong(&out[len], sync.switchMicros);
+    len += 4;
+  }
+  return len;
+}
+
+bool antlerDecodeSync(const uint8_t* data, uint8_t len, AntlerSyncPayload& sync) {
+  if (len < 3 || antlerMessageType(data, len) != ANTLER_MSG_SYNC) return false;
+  bool prevUse = data[2] & ANTLER_SYNC_PREV;
+  bool switchUse = data[2] & ANTLER_SYNC_SWITCH;
+  if (len != 3 + (prevUse ? 4 : 0) + (switchUse ? 5 : 0)) return false;
+
+  uint8_t i = 3;
+  sync.seq = data[1];
+  sync.prevUse = prevUse;
+  sync.prevMicros = 0;
+  if (prevUse) {
+    sync.prevMicros = getLong(&data[i]);
+    i += 4;
+  }
+  sync.switchUse = switchUse;
+  sync.profile = switchUse ? data[i] : 0;
+  sync.switchMicros = switchUse ? getLong(&data[i + 1]) : 0;
+  sync.telemetryUse = data[2] & ANTLER_SYNC_TELEMETRY;
+  return true;
+}
+
+void AntlerCueTracker::heard(uint8_t seq) {
+  if (!_heard) {
+    _heard = true;
+    _seq = seq;
+    _seen = 0xFF; // nothing before the first cue counts as missed
+    return;
+  }
+  int8_t ahead = seq - _seq;
+  if (ahead > 0) {
+    // everything between the old newest and seq was missed
+    _seen = ahead > 8 ? 0 : (uint8_t)(((_seen << 1) | 1) << (ahead - 1));
+    _seq = seq;
+  }
+  else if (ahead >= -8) {
+    if (ahead < 0) _seen |= 1 << (-ahead - 1); // a repair
+  }
+  else {
+    // further back than any repair: the controller restarted and numbers from 0 again,
+    // so start over, with the cues before seq in this numbering missed
+    _seq = seq;
+    _seen = seq >= 8 ? 0 : (uint8_t)(0xFF << seq);
+    _applied = false;
+  }
+}
+
+void AntlerCueTracker::report(ToControllersPayload& telemetry) const {
+  telemetry.cueSeqUse = _heard;
+  telemetry.cueSeq = _seq;
+  telemetry.cueMissed = ~_seen;
+}
+
+void AntlerClock::beacon(const AntlerSyncPayload& sync, uint32_t rxMicros) {
+  // the previous beacon's send and receive times make a sync point
+  if (sync.prevUse && _rxUse && (uint8_t)(sync.seq - 1) == _rxSeq) {
+    if (_synced) {
+      uint32_t local = _rxMicros - _localRef;
+      if (local >= ANTLER_SYNC_MIN_SPAN_US && local <= ANTLER_SYNC_MAX_SPAN_US) {
+        float drift = (float)(int32_t)(sync.prevMicros - _networkRef - local) / local;
+        if (drift > ANTLER_SYNC_MAX_DRIFT || drift < -ANTLER_SYNC_MAX_DRIFT) {
+          _drift = 0; // the controller restarted, start over from the new time base
+          _driftUse = false;
+        }
+        else {
+          _drift = _driftUse ? _drift + (drift - _drift) / 4 : drift; // smooth out interrupt latency jitter
+          _driftUse = true;
+        }
+      }
+    }
+    _localRef = _rxMicros;
+    _networkRef = sync.prevMicros;
+    _synced = true;
+  }
+  _rxSeq = sync.seq;
+  _rxMicros = rxMicros;
+  _rxUse = true;
+}
+
+uint32_t AntlerClock::toLocal(uint32_t networkMicros) const {
+  int32_t elapsed = networkMicros - _networkRef;
+  return _localRef + elapsed - (int32_t)(elapsed * _drift);
+}
+
+uint32_t AntlerClock::toNetwork(uint32_t localMicros) const {
+  int32_t elapsed = localMicros - _localRef;
+  return _networkRef + elapsed + (int32_t)(elapsed * _drift);
+}
+
+uint32_t AntlerClock::waitUs(const ToAntlersPayload& cue, uint32_t localNow) const {
+  if (!_synced || !cue.atUse) return 0;
+  int32_t wait = toLocal(cue.atMicros) - localNow;
+  return wait > 0 && (uint32_t)wait <= ANTLER_SYNC_MAX_WAIT_US ? wait : 0;
+}
+
+void AntlerArmedCues::arm(uint8_t slot, const ToAntlersPayload& cue) {
+  if (slot >= ANTLER_ARM_SLOTS) return;
+  const ToAntlersPayload& last = _cues[slot];
+  if ((_held & (1 << slot)) && cue.seqUse && last.seqUse && !antlerSeqNewer(cue.seq, last.seq)) return;
+  _cues[slot] = cue;
+  _armed |= 1 << slot;
+  _held |= 1 << slot;
+}
+
+bool AntlerArmedCues::go(uint8_t slot, ToAntlersPayload& cue) {
+  if (slot >= ANTLER_ARM_SLOTS || !(_armed & (1 << slot))) return false;
+  _armed &= ~(1 << slot);
+  cue = _cues[slot];
+  return true;
+}
+
+bool AntlerPollSlot::poll(const AntlerPollPayload& poll, uint8_t nodeId, uint32_t rxMicros) {
+  _heard = true;
+  _heardMicros = rxMicros;
+  uint8_t slot = poll.assigned ? _assigned : (uint8_t)(nodeId - poll.firstNode);
+  _pending = slot != ANTLER_SLOT_NONE && slot < poll.slots;
+  _dueMicros = rxMicros + ANTLER_POLL_START_US + (uint32_t)slot * poll.slotUs;
+  return _pending;
+}
+
+uint32_t AntlerPollSlot::waitUs(uint32_t localNow) const {
+  int32_t wait = _dueMicros - localNow;
+  return _pending && wait > 0 ? wait : 0;
+}
+
+bool AntlerPollSlot::due(uint32_t localNow) {
+  int32_t late = localNow - _dueMicros;
+  if (!_pending || late < 0) return false;
+  _pending = false;
+  return late <= ANTLER_POLL_LATE_US;
+}
+
+void AntlerProfileSwitch::beacon(const AntlerSyncPayload& sync, uint32_t localNow) {
+  _timing = true;
+  _heardMicros = localNow;
+  _pending = sync.switchUse && sync.profile < ANTLER_PROFILES; // a beacon without one cancels it
+  _next = sync.profile;
+  _switchMicros = sync.switchMicros;
+}
+
+bool AntlerProfileSwitch::poll(const AntlerClock& clock, uint32_t localNow, uint8_t& profile) {
+  if (!_timing) {
+    _timing = true; // the lost timer starts at the first poll
+    _heardMicros = localNow;
+  }
+  if (_pending && clock.synced() && (int32_t)(localNow - clock.toLocal(_switchMicros)) >= 0) {
+    _pending = false;
+    _profile = _next;
+  }
+  else if (localNow - _heardMicros >= ANTLER_PROFILE_LOST_US) {
+    _pending = false;
+    _profile = (_profile + 1) % ANTLER_PROFILES;
+  }
+  else return false;
+  _heardMicros = localNow; // give the new profile a full ANTLER_PROFILE_LOST_US
+  profile = _profile;
+  return true;
+}
@@ -0,0 +1,372 @@
+// **********************************************************************************
+// Over-the-air payloads shared by the Wireless Antlers controller and antler hats
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// The structs are the in-memory form. On air they are sent with the packed codec
+// below, never as raw structs (whose size and layout differ between compilers):
+//
+//   header(1)  bits 0-3 message type, bits 4-7 ANTLER_WIRE_VERSION
+//   ANTLER_MSG_CUE        state(1) flags(1) [seq(1)] [group(1)] [copiesLeft(1) fireInMs(1)]
+//                         [atMicros(4)] [sleepTime(varint)]
+//     flags = ANTLER_CUE_* bits, seq only present with ANTLER_CUE_SEQ, group only
+//     with ANTLER_CUE_GROUP, copiesLeft/fireInMs only with ANTLER_CUE_BURST, atMicros
+//     only with ANTLER_CUE_AT and sleepTime only with ANTLER_CUE_SLEEPTIMEUSE
+//   ANTLER_MSG_GROUPS     groups(2)
+//     sets the receiving hat's group membership, bit n-1 = member of group n
+//   ANTLER_MSG_TELEMETRY  state(1) flags(1) vcc(2) temperature(1) cueSeq(1) cueMissed(1)
+//     flags = ANTLER_TELEMETRY_* bits, vcc in mV, temperature in C (signed),
+//     cueSeq/cueMissed only meaningful with ANTLER_TELEMETRY_CUESEQ
+//   ANTLER_MSG_ARM        slot(1) state(1) flags(1) [seq(1)] [group(1)] [sleepTime(varint)]
+//     the body of a cue, stored in one of the hat's ANTLER_ARM_SLOTS slots instead of
+//     acted on; never carries the burst fields or atMicros
+//   ANTLER_MSG_GO         slot(1)
+//     broadcast, every hat with that slot armed acts on the cue in it and empties it
+//   ANTLER_MSG_SYNC       seq(1) flags(1) [prevMicros(4)] [profile(1) switchMicros(4)]
+//     broadcast time beacon, prevMicros = controller micros() when beacon seq-1 finished
+//     transmitting, only with ANTLER_SYNC_PREV; with ANTLER_SYNC_SWITCH the whole network
+//     changes to radio profile at network time switchMicros; ANTLER_SYNC_TELEMETRY tells
+//     hats to send telemetry on ANTLER_TELEMETRY_FREQUENCY instead of the cue channel
+//   ANTLER_MSG_POLL       firstNode(1) slots(1) slotUs(2) flags(1)
+//     broadcast, starts a telemetry sweep of slots slots of slotUs each; node firstNode+n
+//     answers in slot n, or with ANTLER_POLL_ASSIGNED each hat in its ANTLER_MSG_SLOT slot
+//   ANTLER_MSG_SLOT       slot(1)
+//     sets the receiving hat's assigned poll slot, ANTLER_SLOT_NONE clears it
+//   ANTLER_MSG_STATUS     -
+//     unicast, the hat answers with one ANTLER_MSG_TELEMETRY frame as soon as it can,
+//     with carrier sense as usual, whether or not sweeps keep it quiet
+//
+// varint = unsigned LEB128, 7 bits per byte, low bits first. Multi-byte fields are
+// little endian. nodeId is not sent, the decoders take it from the radio's SENDERID,
+// and version is filled in from the header. Decoders reject any other wire version.
+//
+// A group cue is broadcast once and acted on only by the hats in that group, so a
+// zone of hats costs one frame instead of one unicast per hat.
+//
+// Broadcast cues are not ACKed. Instead the controller numbers them (seq, wrapping)
+// and each hat reports the newest seq it heard plus a bitmask of the 8 before it that
+// it missed (bit n = seq cueSeq-1-n). The controller re-sends just those cues to just
+// that hat, unicast with their original seq; see AntlerCueTracker for the hat side.
+// Numbering starts at 0 whenever the controller starts. A hat that hears a seq further
+// back than any repair goes (8) takes it as a restart and starts over from there; one
+// whose last seq was 8 or fewer past the restart point takes the first few new cues
+// for old ones until the numbering passes it.
+//
+// Show critical cues can also go out as a burst: the same numbered cue K times a few
+// ms apart. Each copy says how many copies follow and how long after receiving it
+// the hat should act, so hats act once (by seq) and together whichever copy they get.
+//
+// Network time is the controller's micros(). A beacon can't carry its own send time,
+// so each one carries the time the previous one left the antenna (the PacketSent
+// interrupt) and the hat pairs that with the time it received the previous one (the
+// PayloadReady interrupt): one sync point per beacon. AntlerClock keeps the latest point
+// and the drift between the two crystals, and maps network time to the hat's micros().
+// Broadcast cues carry the network time to act at (atMicros), so a hat acts at the same
+// instant whether it got the cue first time, after CSMA waits or from a later burst copy.
+//
+// A cue can also be armed ahead of time and fired by a two byte GO frame, which keeps
+// the full payload, its repairs and any retries off the critical path. Arm frames are
+// numbered broadcasts like cues, so the usual repairs fill in hats that missed one; only
+// hats in the cue's group store it, so different groups can hold different cues in the
+// same slot and one GO fires them all. As acting empties the slot, the host can repeat
+// a GO for hats that missed it without firing anyone twice.
+//
+// The radio profile (bitrate and filters, RF69_PROFILE_*) changes in two phases: the
+// controller announces the profile and a switch time on every beacon, sent 4x as often
+// until then, and at that network time the controller and every hat switch together.
+// A hat that missed every announcement stops hearing beacons; after
+// ANTLER_PROFILE_LOST_US it tries the next profile, and so on until it finds the
+// network again. See AntlerProfileSwitch.
+//
+// A controller with a second radio receives telemetry on its own channel, so hat
+// chatter never holds up a cue. It sets ANTLER_SYNC_TELEMETRY on its beacons and hats
+// hop to ANTLER_TELEMETRY_FREQUENCY just to send telemetry, listening on the cue
+// channel the rest of the time. Hats that haven't heard a beacon say so report on the
+// cue channel, which the controller keeps listening on.
+//
+// Telemetry can also be collected in sweeps, without any two hats contending. A poll
+// beacon starts a superframe: slot 0 begins ANTLER_POLL_START_US after the poll is
+// received, and each hat sends one telemetry frame at the start of its slot, straight
+// away without carrier sense. The controller makes a slot the telemetry frame's airtime
+// plus ANTLER_POLL_GUARD_US for the transmitter ramp, interrupt latency and clock error,
+// so a sweep takes a known ANTLER_POLL_START_US + slots * slotUs. A hat that heard a poll
+// in the last ANTLER_POLL_QUIET_US sends no telemetry of its own, so sweeps have the
+// channel to themselves. See AntlerPollSlot.
+// **********************************************************************************
+#ifndef AntlerProtocol_h
+#define AntlerProtocol_h
+#include <Arduino.h>
+
+// struct for packets being sent to antler hats
+typedef struct {
+  byte  nodeId; // Sender node ID
+  byte  version; // What version payload
+  byte  state; // What state are we being told to go into?
+  bool  antlerState; // What state do we want the actual antlers to be in?
+  bool  antlerStateUse; // Should we pay attention to the incoming Antler state?
+  long  sleepTime; // In milliseconds. Used if we want to overwrite pre-defined states
+  bool  sleepTimeUse; // Should we pay attention to the incoming sleep time?
+  byte  group; // Only hats in this group act on it, 0 = every hat the frame reaches
+  byte  seq; // Broadcast sequence number
+  bool  seqUse; // Is seq set? Only broadcasts and their repairs are numbered
+  byte  copiesLeft; // Burst copies still to come after this one
+  byte  fireInMs; // Act this long after receiving it, so every copy of a burst fires together
+  unsigned long atMicros; // Network time to act at, for hats synced by ANTLER_MSG_SYNC beacons
+  bool  atUse; // Is atMicros set?
+} ToAntlersPayload;
+
+// struct for packets being sent to controllers
+typedef struct {
+  byte  nodeId; // Sender node ID
+  byte  version; // What version payload
+  byte  state; // What state Hat node is currently in
+  bool  antlerState; // What state the antlers are currently in
+  float vcc; // VCC read from battery monitor
+  int   temperature; // Temperature of the radio
+  byte  cueSeq; // Newest broadcast cue seq heard
+  byte  cueMissed; // Bit n set = missed broadcast cue cueSeq-1-n
+  bool  cueSeqUse; // Has any numbered cue been heard yet?
+} ToControllersPayload;
+
+// struct for time sync beacons
+typedef struct {
+  byte  seq; // Beacon sequence number
+  unsigned long prevMicros; // Controller micros() when beacon seq-1 finished transmitting
+  bool  prevUse; // Is prevMicros set?
+  byte  profile; // Radio profile to switch to
+  unsigned long switchMicros; // Network time to switch at
+  bool  switchUse; // Is a switch announced?
+  bool  telemetryUse; // Should hats send telemetry on ANTLER_TELEMETRY_FREQUENCY?
+} AntlerSyncPayload;
+
+// struct for telemetry poll beacons
+typedef struct {
+  byte  firstNode; // Node answering in slot 0
+  byte  slots; // Slots in the sweep
+  unsigned int slotUs; // Width of each slot
+  bool  assigned; // Answer in the ANTLER_MSG_SLOT slot instead of by node ID?
+} AntlerPollPayload;
+
+#define ANTLER_WIRE_VERSION   2 // version 1 was the raw structs
+
+// message types
+#define ANTLER_MSG_CUE        0x01
+#define ANTLER_MSG_TELEMETRY  0x02
+#define ANTLER_MSG_GROUPS     0x03
+#define ANTLER_MSG_SYNC       0x04
+#define ANTLER_MSG_ARM        0x05
+#define ANTLER_MSG_GO         0x06
+#define ANTLER_MSG_POLL       0x07
+#define ANTLER_MSG_SLOT       0x08
+#define ANTLER_MSG_STATUS     0x09
+
+// ANTLER_MSG_CUE flags
+#define ANTLER_CUE_ANTLERSTATE     0x01
+#define ANTLER_CUE_ANTLERSTATEUSE  0x02
+#define ANTLER_CUE_SLEEPTIMEUSE    0x04
+#define ANTLER_CUE_GROUP           0x08
+#define ANTLER_CUE_SEQ             0x10
+#define ANTLER_CUE_BURST           0x20 // copiesLeft or fireInMs set
+#define ANTLER_CUE_AT              0x40
+
+// ANTLER_MSG_SYNC flags
+#define ANTLER_SYNC_PREV           0x01
+#define ANTLER_SYNC_SWITCH         0x02
+#define ANTLER_SYNC_TELEMETRY      0x04
+
+// ANTLER_MSG_POLL flags
+#define ANTLER_POLL_ASSIGNED       0x01
+
+// ANTLER_MSG_TELEMETRY flags
+#define ANTLER_TELEMETRY_ANTLERSTATE 0x01
+#define ANTLER_TELEMETRY_CUESEQ      0x02
+
+#define ANTLER_VARINT_MAX     5 // a 32 bit value
+#define ANTLER_CUE_MAX_LEN    (11 + ANTLER_VARINT_MAX)
+#define ANTLER_TELEMETRY_LEN  8
+#define ANTLER_GROUPS_LEN     3
+#define ANTLER_GROUPS         16 // groups 1-16, one membership bit each
+#define ANTLER_SYNC_MAX_LEN   12
+#define ANTLER_ARM_MAX_LEN    (ANTLER_CUE_MAX_LEN + 1 - 6) // + slot, - burst fields and atMicros
+#define ANTLER_GO_LEN         2
+#define ANTLER_ARM_SLOTS      4
+#define ANTLER_POLL_LEN       6
+#define ANTLER_SLOT_LEN       2
+#define ANTLER_SLOT_NONE      0xFF
+#define ANTLER_STATUS_LEN     1
+
+#define ANTLER_SYNC_MIN_SPAN_US  250000UL   // sync points closer than this don't update the drift
+#define ANTLER_SYNC_MAX_SPAN_US  60000000UL // nor further apart than this
+#define ANTLER_SYNC_MAX_DRIFT    0.0005f    // 500ppm, anything more is the controller restarting
+#define ANTLER_SYNC_MAX_WAIT_US  1000000UL  // a cue further ahead than this means a stale clock
+
+#define ANTLER_PROFILES          3          // radio profiles 0-2, RF69_PROFILE_* in the driver
+#define ANTLER_PROFILE_LOST_US   5500000UL  // no beacon for this long, try the next profile
+
+#define ANTLER_TELEMETRY_FREQUENCY 918000000UL // Hz, telemetry channel of a dual radio controller
+
+#define ANTLER_POLL_START_US     1000       // poll received to the start of slot 0
+#define ANTLER_POLL_GUARD_US     400        // slot width on top of the telemetry frame's airtime
+#define ANTLER_POLL_LATE_US      (ANTLER_POLL_GUARD_US / 2) // a hat later than this skips its slot
+#define ANTLER_POLL_QUIET_US     10000000UL // no telemetry outside slots this long after a poll
+
+static_assert(ANTLER_WIRE_VERSION <= 0x0F, "the wire version is a nibble of the header");
+static_assert(ANTLER_CUE_MAX_LEN < sizeof(ToAntlersPayload), "an encoded cue must be shorter than the raw struct");
+static_assert(ANTLER_TELEMETRY_LEN < sizeof(ToControllersPayload), "encoded telemetry must be shorter than the raw struct");
+
+// Should a hat with this membership act on a cue for group?
+inline bool antlerInGroup(uint16_t groups, uint8_t group) {
+  return group == 0 || (group <= ANTLER_GROUPS && (groups & (1U << (group - 1))));
+}
+
+// Is sequence number a newer than b? Valid while they are less than 128 apart.
+inline bool antlerSeqNewer(uint8_t a, uint8_t b) {
+  return (int8_t)(a - b) > 0;
+}
+
+// Hat side bookkeeping for numbered broadcast cues
+class AntlerCueTracker {
+  public:
+    AntlerCueTracker() : _heard(false), _applied(false), _seq(0), _seen(0), _appliedSeq(0) {}
+
+    // Call for every cue with seqUse, whether or not this hat acts on it. A seq more
+    // than 8 behind the newest means the controller restarted, and the tracker resyncs.
+    void heard(uint8_t seq);
+    // Should a numbered cue be acted on? Not if a newer one already was, so a late repair
+    // never rolls a hat back. Call applied() when acting on it.
+    bool isNew(uint8_t seq) const { return !_applied || antlerSeqNewer(seq, _appliedSeq); }
+    void applied(uint8_t seq) { _applied = true; _appliedSeq = seq; }
+
+    // Fill in cueSeq, cueMissed and cueSeqUse of outgoing telemetry
+    void report(ToControllersPayload& telemetry) const;
+
+  private:
+    bool _heard;
+    bool _applied;
+    uint8_t _seq;        // newest seq heard
+    uint8_t _seen;       // bit n = seq _seq-1-n heard
+    uint8_t _appliedSeq;
+};
+
+// Hat side clock sync from ANTLER_MSG_SYNC beacons
+class AntlerClock {
+  public:
+    AntlerClock() : _synced(false), _rxUse(false), _driftUse(false), _rxSeq(0), _rxMicros(0),
+                    _localRef(0), _networkRef(0), _drift(0) {}
+
+    // Call for every beacon with the local micros() of its PayloadReady interrupt
+    void beacon(const AntlerSyncPayload& sync, uint32_t rxMicros);
+    // Has a sync point been taken yet? Before that network times mean nothing to this hat.
+    bool synced() const { return _synced; }
+
+    uint32_t toLocal(uint32_t networkMicros) const;
+    uint32_t toNetwork(uint32_t localMicros) const;
+    // Drift of the controller's clock against this one, in ppm
+    float driftPpm() const { return _drift * 1e6f; }
+
+    // Microseconds from local time localNow until a cue's atMicros. 0 if it has passed, isn't
+    // set, this hat isn't synced or it is more than ANTLER_SYNC_MAX_WAIT_US away.
+    uint32_t waitUs(const ToAntlersPayload& cue, uint32_t localNow) const;
+
+  private:
+    bool _synced;
+    bool _rxUse;
+    bool _driftUse;
+    uint8_t _rxSeq;       // last beacon received
+    uint32_t _rxMicros;   // and when
+    uint32_t _localRef;   // latest sync point, local time
+    uint32_t _networkRef; // and network time
+    float _drift;         // network time gained per local microsecond
+};
+
+// Hat side radio profile: follows announced switches and hunts for the network when lost
+class AntlerProfileSwitch {
+  public:
+    AntlerProfileSwitch() : _profile(0), _next(0), _pending(false), _timing(false), _switchMicros(0), _heardMicros(0) {}
+
+    // Call for every beacon, after AntlerClock::beacon()
+    void beacon(const AntlerSyncPayload& sync, uint32_t localNow);
+    // Call from loop(). Returns true, with the profile to set the radio to, when an
+    // announced switch is due or no beacon has been heard for ANTLER_PROFILE_LOST_US.
+    bool poll(const AntlerClock& clock, uint32_t localNow, uint8_t& profile);
+    uint8_t profile() const { return _profile; }
+
+  private:
+    uint8_t _profile;
+    uint8_t _next;          // announced profile
+    bool _pending;
+    bool _timing;           // _heardMicros is set
+    uint32_t _switchMicros; // network time of the announced switch
+    uint32_t _heardMicros;  // local time of the last beacon or profile change
+};
+
+// Hat side slots for cues armed with ANTLER_MSG_ARM
+class AntlerArmedCues {
+  public:
+    AntlerArmedCues() : _armed(0), _held(0) {}
+
+    // Replaces whatever the slot held, unless that was a newer numbered cue (a late repair)
+    void arm(uint8_t slot, const ToAntlersPayload& cue);
+    // On ANTLER_MSG_GO: takes the armed cue out of the slot, false if it is empty
+    bool go(uint8_t slot, ToAntlersPayload& cue);
+
+  private:
+    ToAntlersPayload _cues[ANTLER_ARM_SLOTS];
+    uint8_t _armed; // bit n = slot n holds a cue
+    uint8_t _held;  // bit n = _cues[n] was ever set, fired or not
+};
+
+// Hat side slot of ANTLER_MSG_POLL sweeps
+class AntlerPollSlot {
+  public:
+    AntlerPollSlot() : _assigned(ANTLER_SLOT_NONE), _pending(false), _heard(false), _dueMicros(0), _heardMicros(0) {}
+
+    // On ANTLER_MSG_SLOT
+    void assign(uint8_t slot) { _assigned = slot; }
+    // Call for every poll with the local micros() of its PayloadReady interrupt. True if
+    // this hat has a slot in the sweep
+    bool poll(const AntlerPollPayload& poll, uint8_t nodeId, uint32_t rxMicros);
+    // Microseconds from localNow until the slot, 0 once it has begun
+    uint32_t waitUs(uint32_t localNow) const;
+    // Call from loop(): true once when the slot begins, the hat then sends its telemetry
+    // right away. Further than ANTLER_POLL_LATE_US into the slot it is skipped instead.
+    bool due(uint32_t localNow);
+    // Was a poll heard in the last ANTLER_POLL_QUIET_US? Then telemetry only goes in slots
+    bool quiet(uint32_t localNow) const { return _heard && localNow - _heardMicros < ANTLER_POLL_QUIET_US; }
+
+  private:
+    uint8_t _assigned;
+    bool _pending;         // a slot in the current sweep is still to come
+    bool _heard;
+    uint32_t _dueMicros;   // local time the slot begins
+    uint32_t _heardMicros; // and the poll arrived
+};
+
+// Message type of a received frame, 0 if it is empty or of another wire version
+uint8_t antlerMessageType(const uint8_t* data, uint8_t len);
+
+// Encoders write to out and return the frame length
+uint8_t antlerEncodeCue(const ToAntlersPayload& cue, uint8_t* out);
+uint8_t antlerEncodeTelemetry(const ToControllersPayload& telemetry, uint8_t* out);
+uint8_t antlerEncodeGroups(uint16_t groups, uint8_t* out);
+uint8_t antlerEncodeSync(const AntlerSyncPayload& sync, uint8_t* out);
+uint8_t antlerEncodeArm(uint8_t slot, const ToAntlersPayload& cue, uint8_t* out);
+uint8_t antlerEncodeGo(uint8_t slot, uint8_t* out);
+uint8_t antlerEncodePoll(const AntlerPollPayload& poll, uint8_t* out);
+uint8_t antlerEncodeSlot(uint8_t slot, uint8_t* out);
+uint8_t antlerEncodeStatus(uint8_t* out);
+
+// Decoders return false, leaving the payload untouched, unless the frame is a well formed
+// message of that type and the current wire version
+bool antlerDecodeCue(const uint8_t* data, uint8_t len, uint8_t senderId, ToAntlersPayload& cue);
+bool antlerDecodeTelemetry(const uint8_t* data, uint8_t len, uint8_t senderId, ToControllersPayload& telemetry);
+bool antlerDecodeGroups(const uint8_t* data, uint8_t len, uint16_t& groups);
+bool antlerDecodeSync(const uint8_t* data, uint8_t len, AntlerSyncPayload& sync);
+bool antlerDecodeArm(const uint8_t* data, uint8_t len, uint8_t senderId, uint8_t& slot, ToAntlersPayload& cue);
+bool antlerDecodeGo(const uint8_t* data, uint8_t len, uint8_t& slot);
+bool antlerDecodePoll(const uint8_t* data, uint8_t len, AntlerPollPayload& poll);
+bool antlerDecodeSlot(const uint8_t* data, uint8_t len, uint8_t& slot);
+bool antlerDecodeStatus(const uint8_t* data, uint8_t len);
+
+#endif
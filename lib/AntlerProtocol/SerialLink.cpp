@@ -0,0 +1,69 @@
+// **********************************************************************************
+// Framed binary command channel, see SerialLink.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "SerialLink.h"
+
+uint16_t crc16(const uint8_t* data, uint8_t len, uint16_t crc) {
+  while (len--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (uint8_t i = 0; i < 8; i++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+uint8_t serialFrameEncode(const uint8_t* data, uint8_t len, uint8_t* out) {
+  uint16_t crc = crc16(data, len);
+  uint8_t codeIndex = 0;
+  uint8_t o = 1;
+  uint8_t code = 1;
+  for (uint8_t i = 0; i < len + 2; i++) {
+    uint8_t b = i < len ? data[i] : (i == len ? crc & 0xFF : crc >> 8);
+    if (b != 0) {
+      out[o++] = b;
+      code++;
+    }
+    if (b == 0 || code == 0xFF) {
+      out[codeIndex] = code;
+      codeIndex = o++;
+      code = 1;
+    }
+  }
+  out[codeIndex] = code;
+  out[o++] = SERIAL_FRAME_DELIM;
+  return o;
+}
+
+bool SerialFrameReader::feed(uint8_t b) {
+  if (b != SERIAL_FRAME_DELIM) {
+    if (_len < sizeof(_buf)) _buf[_len++] = b;
+    else _overrun = true;
+    return false;
+  }
+
+  bool ok = !_overrun && _len > 0 && decode();
+  _len = 0;
+  _overrun = false;
+  return ok;
+}
+
+uint8_t serialFrameDecode(uint8_t* buf, uint8_t len) {
+  uint8_t r = 0, w = 0;
+  while (r < len) {
+    uint8_t code = buf[r++];
+    if (code == 0 || r + code - 1 > len) return 0; // malformed
+    for (uint8_t i = 1; i < code; i++) buf[w++] = buf[r++];
+    if (code != 0xFF && r < len) buf[w++] = 0;
+  }
+
+  if (w < 3 || crc16(buf, w - 2) != (buf[w - 2] | ((uint16_t)buf[w - 1] << 8))) return 0;
+  return w - 2;
+}
+
+bool SerialFrameReader::decode() {
+  _frameLen = serialFrameDecode(_buf, _len);
+  return _frameLen != 0;
+}
@@ -0,0 +1,233 @@
+// **********************************************************************************
+// Framed binary command channel between the show host and the controller
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+// Each frame is COBS encoded and terminated by a single 0x00 byte, so the reader can
+// resynchronise on the next 0x00 after any garbage. Decoded, a frame is:
+//
+//   [type] [body ...] [CRC16 LSB] [CRC16 MSB]
+//
+// CRC16 is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over type + body.
+// Multi-byte fields are little endian.
+//
+//   SERIAL_CMD_CUE         node(1) state(1) flags(1) sleepTime(4)
+//     node 0 = broadcast; flags = SERIAL_CUE_* bits; with SERIAL_CUE_GROUP node is
+//     a group (1-16) instead, the cue is broadcast and only that group's hats act on it;
+//     a broadcast or group cue with SERIAL_CUE_BURST goes out as a redundant burst
+//   SERIAL_CMD_SHOW_ERASE  -                    clear the show stored in SPI flash
+//   SERIAL_CMD_SHOW_CUE    index(2) atMs(4) node(1) state(1) flags(1) sleepTime(4)
+//     atMs = offset from show start, cues must be stored in ascending atMs order
+//   SERIAL_CMD_SHOW_COMMIT count(2)             seal the show after its last cue
+//   SERIAL_CMD_SHOW_START  fromMs(4)            play the stored show, fromMs into it
+//   SERIAL_CMD_SHOW_STOP   -
+//   SERIAL_CMD_FLEET_DUMP  mode(1)              mode = SERIAL_FLEET_* bits
+//   SERIAL_CMD_OUTPUT      mode(1)              SERIAL_OUTPUT_TEXT or SERIAL_OUTPUT_BINARY
+//   SERIAL_CMD_GROUPS      node(1) groups(2)    push a hat's group membership, bit n-1 = group n
+//   SERIAL_CMD_BURST       copies(1) spacingMs(1)  shape of SERIAL_CUE_BURST bursts, see CueBurst.h
+//   SERIAL_CMD_PROFILE     profile(1) afterMs(2)  move the whole network to radio profile
+//     (RF69_PROFILE_*) afterMs from now, at least 1000ms to announce it; see AntlerProtocol.h
+//   SERIAL_CMD_ARM         slot(1) node(1) state(1) flags(1) sleepTime(4)
+//     like SERIAL_CMD_CUE, but the hats store the cue in slot (0-3) until a GO for it;
+//     SERIAL_CUE_BURST is ignored
+//   SERIAL_CMD_GO          slot(1) copies(1)    broadcast a GO, every hat armed in slot acts;
+//     copies (1-3) GO frames go out back to back, hats that miss the first act on a later
+//     one a frame time (~1.5ms) late and the rest ignore it, their slot is already empty
+//   SERIAL_CMD_RADIO_STATS radio(1) flags(1)   dump the driver counters (RFM69Stats) of
+//     radio 0 (cues) or 1 (telemetry, DUAL_RADIO); with SERIAL_STATS_RESET they restart from 0
+//     once the last part is read, so whatever is counted between the parts is not reported
+//   SERIAL_CMD_LOOP_STATS  flags(1)            dump the controller's loop() latency histograms
+//     (LoopProfiler.h); with SERIAL_STATS_RESET each section restarts once it has been sent
+//   SERIAL_CMD_AIRTIME     -                    dump each hat's airtime in the last second
+//     (NodeAirtime.h)
+//   SERIAL_CMD_POLL        firstNode(1) slots(1) flags(1) periodMs(2)
+//     collect telemetry in sweeps of slots slots, node firstNode answering in the first
+//     (SERIAL_POLL_ASSIGNED: each hat in its SERIAL_CMD_SLOT slot), every periodMs (at
+//     least 100) or once with periodMs 0; slots 0 stops, see TelemetryPoll.h
+//   SERIAL_CMD_SLOT        node(1) slot(1)      push a hat's assigned poll slot, 255 clears it
+//   SERIAL_CMD_FLEET_POLL  firstNode(1) nodes(1) window(1) timeoutMs(1) periodMs(2)
+//     ask nodes hats from firstNode for their status one by one, window (1-8) requests
+//     outstanding with timeoutMs (at least 10) each, every periodMs (at least 100) or once
+//     with periodMs 0; nodes 0 stops; firstNode 0 (broadcast) is rejected, see FleetPoller.h
+// A show is loaded with ERASE, the cues, then COMMIT; see ShowPlayer.h.
+//
+// Replies (controller -> host) use the same framing. The controller also prints text,
+// so it sends a delimiter ahead of each reply frame to end any partial line.
+//
+//   SERIAL_RSP_FLEET       flags(1) record(6)...
+//     one FleetTable.h record per node heard from, a dump spans as many frames as it
+//     needs and its last frame has SERIAL_FLEET_LAST set (possibly with no records);
+//     SERIAL_FLEET_UNTRACKED on the last frame = packets came from node IDs beyond the
+//     table (FLEET_MAX_NODES) since the previous dump, see FleetTable.h
+//   SERIAL_RSP_TELEMETRY   dropped(1) record(8)...
+//     packets received since the previous frame, in SERIAL_OUTPUT_BINARY mode only.
+//     record = node(1) version(1) state(1) flags(1) vcc(2) temperature(1) rssi(1)
+//     flags bit 0 = antlerState, vcc in mV, temperature in C, rssi in dBm (signed);
+//     dropped = records lost because the serial link could not keep up
+//   SERIAL_RSP_RADIO_STATS radio(1) part(1) ...   one frame per part, each read as it is sent
+//     SERIAL_STATS_COUNTERS    powerLevel(1) sent(4) received(4) addressFiltered(2)
+//                              badFrames(2) rxDropped(2) rxRestarts(2) csmaTimeouts(2)
+//                              txTimeouts(2) retryFailures(2) csmaBusy(2) txAirtimeUs(4)
+//                              rxAirtimeUs(4) lastTxUs(4) lastRxUs(4)
+//     airtimes are running totals (RFM69Stats), last* the airtime of the last whole second
+//     (RFM69::lastAirtime()), / 10000 for the share of the channel in percent
+//     SERIAL_STATS_HISTOGRAMS  csmaWait(2)x8 ackRtt(2)x8 retries(2)x4
+//     histogram bucket 0 is under 1ms, bucket n 2^(n-1) to 2^n ms, the last one open ended;
+//     retries[n] = sendWithRetry() calls ACKed after n retries (3 = 3 or more)
+//   SERIAL_RSP_LOOP_STATS  section(1) count(4) maxUs(4) p99Us(4) buckets(2)x16
+//     one frame per PROFILE_* section; bucket 0 is under 4us, bucket n 2^(n+1) to 2^(n+2) us
+//   SERIAL_RSP_AIRTIME     flags(1) record(2)...
+//     record = node(1) airtime(1) in 256us steps, for every node heard in the last second;
+//     like SERIAL_RSP_FLEET the last frame of a dump has SERIAL_FLEET_LAST set
+//   SERIAL_RSP_POLL        slots(1) answered(1) sweepUs(4)
+//     after each sweep: the nodes heard from in it and the time from the poll being due
+//     to the end of the last slot
+//   SERIAL_RSP_FLEET_POLL  nodes(1) answered(1) timeouts(2) sweepUs(4)
+//     after each SERIAL_CMD_FLEET_POLL sweep: the hats that answered, the requests that
+//     timed out and the time from the first request to the last answer or timeout
+// **********************************************************************************
+#ifndef SerialLink_h
+#define SerialLink_h
+#include <Arduino.h>
+
+#define SERIAL_FRAME_MAX   32 // largest decoded frame, including type and CRC
+#define SERIAL_FRAME_DELIM 0x00
+
+// command types (host -> controller)
+#define SERIAL_CMD_CUE         0x01
+#define SERIAL_CMD_SHOW_ERASE  0x02
+#define SERIAL_CMD_SHOW_CUE    0x03
+#define SERIAL_CMD_SHOW_COMMIT 0x04
+#define SERIAL_CMD_SHOW_START  0x05
+#define SERIAL_CMD_SHOW_STOP   0x06
+#define SERIAL_CMD_FLEET_DUMP  0x07
+#define SERIAL_CMD_OUTPUT      0x08
+#define SERIAL_CMD_GROUPS      0x09
+#define SERIAL_CMD_BURST       0x0A
+#define SERIAL_CMD_ARM         0x0B
+#define SERIAL_CMD_GO          0x0C
+#define SERIAL_CMD_PROFILE     0x0D
+#define SERIAL_CMD_RADIO_STATS 0x0E
+#define SERIAL_CMD_LOOP_STATS  0x0F
+#define SERIAL_CMD_AIRTIME     0x10
+#define SERIAL_CMD_POLL        0x11
+#define SERIAL_CMD_SLOT        0x12
+#define SERIAL_CMD_FLEET_POLL  0x13
+
+// reply types (controller -> host)
+#define SERIAL_RSP_FLEET       0x81
+#define SERIAL_RSP_TELEMETRY   0x82
+#define SERIAL_RSP_RADIO_STATS 0x83
+#define SERIAL_RSP_LOOP_STATS  0x84
+#define SERIAL_RSP_AIRTIME     0x85
+#define SERIAL_RSP_POLL        0x86
+#define SERIAL_RSP_FLEET_POLL  0x87
+
+// SERIAL_CMD_CUE flags
+#define SERIAL_CUE_ANTLERSTATE     0x01
+#define SERIAL_CUE_ANTLERSTATEUSE  0x02
+#define SERIAL_CUE_SLEEPTIMEUSE    0x04
+#define SERIAL_CUE_GROUP           0x08
+#define SERIAL_CUE_BURST           0x10
+
+// SERIAL_CMD_FLEET_DUMP mode
+#define SERIAL_FLEET_CHANGED       0x01 // only nodes heard from since their last dump
+
+// SERIAL_RSP_FLEET flags
+#define SERIAL_FLEET_LAST          0x01
+#define SERIAL_FLEET_UNTRACKED     0x02 // a node ID beyond the fleet table was heard
+
+// SERIAL_CMD_OUTPUT mode
+#define SERIAL_OUTPUT_TEXT         0x00 // the ID:/VS:/... lines for every packet, as before
+#define SERIAL_OUTPUT_BINARY       0x01 // SERIAL_RSP_TELEMETRY frames, no per packet or per cue text
+
+// SERIAL_RSP_TELEMETRY record flags
+#define SERIAL_TELEMETRY_ANTLERSTATE 0x01
+
+// SERIAL_CMD_RADIO_STATS flags
+#define SERIAL_STATS_RESET         0x01
+
+// SERIAL_CMD_POLL flags
+#define SERIAL_POLL_ASSIGNED       0x01
+
+// SERIAL_RSP_RADIO_STATS parts
+#define SERIAL_STATS_COUNTERS      0x00
+#define SERIAL_STATS_HISTOGRAMS    0x01
+#define SERIAL_STATS_PARTS         2
+#define SERIAL_STATS_BUCKETS       8 // RF69_STATS_BUCKETS
+#define SERIAL_STATS_RETRIES       4 // RF69_STATS_RETRIES
+#define SERIAL_LOOP_BUCKETS        16 // PROFILE_BUCKETS
+
+#define SERIAL_CUE_LEN         8  // type + node + state + flags + sleepTime
+#define SERIAL_SHOW_CUE_LEN    14 // type + index + atMs + cue body
+#define SERIAL_SHOW_COMMIT_LEN 3
+#define SERIAL_SHOW_START_LEN  5
+#define SERIAL_FLEET_DUMP_LEN  2
+#define SERIAL_OUTPUT_LEN      2
+#define SERIAL_GROUPS_LEN      4
+#define SERIAL_BURST_LEN       3
+#define SERIAL_ARM_LEN         9  // type + slot + cue body
+#define SERIAL_GO_LEN          3
+#define SERIAL_PROFILE_LEN     4
+#define SERIAL_TELEMETRY_RECORD_LEN 8
+#define SERIAL_RADIO_STATS_LEN 3
+#define SERIAL_STATS_COUNTERS_LEN   44 // type + radio + part + body
+#define SERIAL_STATS_HISTOGRAMS_LEN (3 + (2 * SERIAL_STATS_BUCKETS + SERIAL_STATS_RETRIES) * 2)
+#define SERIAL_LOOP_STATS_LEN  2
+#define SERIAL_LOOP_SECTION_LEN (14 + SERIAL_LOOP_BUCKETS * 2) // type + section + count + maxUs + p99Us + buckets
+#define SERIAL_AIRTIME_LEN     1
+#define SERIAL_AIRTIME_RECORD_LEN 2
+#define SERIAL_POLL_LEN        6
+#define SERIAL_SLOT_LEN        3
+#define SERIAL_POLL_REPLY_LEN  7
+#define SERIAL_FLEET_POLL_LEN  7
+#define SERIAL_FLEET_POLL_REPLY_LEN 9
+
+inline uint16_t serialGetShort(const uint8_t* p) {
+  return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+inline void serialPutShort(uint8_t* p, uint16_t v) {
+  p[0] = v; p[1] = v >> 8;
+}
+
+inline uint32_t serialGetLong(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void serialPutLong(uint8_t* p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+
+uint16_t crc16(const uint8_t* data, uint8_t len, uint16_t crc = 0xFFFF);
+
+// COBS encodes [data + CRC] followed by the delimiter into out, returns the bytes written.
+// out must hold len + 2 (CRC) + len/254 + 2 bytes.
+uint8_t serialFrameEncode(const uint8_t* data, uint8_t len, uint8_t* out);
+
+// COBS decodes an encoded frame (delimiter stripped) in place and checks its CRC.
+// Returns the length of type + body, 0 for a malformed frame or a bad CRC.
+uint8_t serialFrameDecode(uint8_t* buf, uint8_t len);
+
+// Incremental, non-blocking frame reader: feed it one byte at a time as it arrives
+class SerialFrameReader {
+  public:
+    SerialFrameReader() : _len(0), _frameLen(0), _overrun(false) {}
+
+    // returns true when b completed a frame with a valid CRC, see frame()/length();
+    // malformed, bad CRC and overlong frames are dropped
+    bool feed(uint8_t b);
+    const uint8_t* frame() const { return _buf; }
+    uint8_t length() const { return _frameLen; } // type + body, CRC stripped
+
+  private:
+    bool decode();
+
+    uint8_t _buf[SERIAL_FRAME_MAX + 2]; // encoded frame, decoded in place on the delimiter
+    uint8_t _len;
+    uint8_t _frameLen;
+    bool _overrun;
+};
+
+#endif
@@ -0,0 +1,77 @@
+// **********************************************************************************
+// Native (host) stand-in for the Arduino core, see ArduinoNative.h
+// Only the subset used by this project and the LowPowerLab libraries is provided.
+// Pin numbers follow the Moteino (ATmega328P) variant.
+// **********************************************************************************
+#ifndef Arduino_h
+#define Arduino_h
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH          1
+#define LOW           0
+#define INPUT         0
+#define OUTPUT        1
+#define INPUT_PULLUP  2
+
+#define CHANGE        1
+#define FALLING       2
+#define RISING        3
+
+#define DEC          10
+#define HEX          16
+#define OCT           8
+#define BIN           2
+
+// Moteino pinout
+#define LED_BUILTIN   9
+#define SS           10
+#define MOSI         11
+#define MISO         12
+#define SCK          13
+#define SS_FLASHMEM   8
+
+#define PROGMEM
+#define PGM_P                 const char*
+#define PSTR(s)               (s)
+#define pgm_read_byte(addr)   (*(const uint8_t*)(addr))
+#define pgm_read_word(addr)   (*(const uint16_t*)(addr))
+class __FlashStringHelper;
+#define F(s)                  (reinterpret_cast<const __FlashStringHelper*>(s))
+
+using std::min;
+using std::max;
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void analogWrite(uint8_t pin, int val);
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode);
+void detachInterrupt(uint8_t interruptNum);
+void interrupts(void);
+void noInterrupts(void);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+#include "Print.h"
+
+#endif
@@ -0,0 +1,365 @@
+// **********************************************************************************
+// Native (host) Arduino core implementation, see ArduinoNative.h
+// **********************************************************************************
+#include "ArduinoNative.h"
+#include <Arduino.h>
+#include <SPI.h>
+#include <deque>
+#include <queue>
+#include <vector>
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+#define NATIVE_PINS        32
+#define NATIVE_INTERRUPTS   2 // INT0 on D2, INT1 on D3 like the ATmega328P
+
+namespace {
+  struct Event {
+    uint64_t time;
+    uint64_t seq; // keeps events scheduled for the same time in FIFO order
+    std::function<void()> run;
+    bool operator>(const Event& other) const { return time != other.time ? time > other.time : seq > other.seq; }
+  };
+
+  struct Interrupt {
+    void (*handler)(void);
+    int mode;
+    bool pending;
+    bool masked; // by SPI.usingInterrupt() during a transaction
+  };
+
+  uint64_t _now;
+  uint64_t _eventSeq;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event> > _events;
+
+  uint8_t _pinLevel[NATIVE_PINS];
+  SPIDevice* _spiDevice[NATIVE_PINS];
+  SPIDevice* _spiSelected;
+
+  Interrupt _interrupt[NATIVE_INTERRUPTS];
+  bool _interruptsEnabled = true;
+  bool _inInterrupt;
+  bool _spiUsesInterrupt[NATIVE_INTERRUPTS];
+  uint8_t _spiTransactionDepth;
+
+  std::deque<uint8_t> _serialRx;
+  std::function<void(uint8_t)> _serialSink;
+  uint64_t _serialTxIdleAt; // time the last queued TX byte leaves the UART
+  uint64_t _serialBytesOut;
+
+  uint8_t interruptPin(uint8_t interruptNum) { return interruptNum == 0 ? 2 : 3; }
+
+  void dispatchInterrupts() {
+    if (_inInterrupt || !_interruptsEnabled) return;
+    for (uint8_t i = 0; i < NATIVE_INTERRUPTS; i++) {
+      Interrupt& irq = _interrupt[i];
+      if (!irq.pending || irq.masked || irq.handler == nullptr) continue;
+      irq.pending = false;
+      _inInterrupt = true;
+      irq.handler();
+      _inInterrupt = false;
+    }
+  }
+
+  void runEvents(uint64_t until) {
+    while (!_events.empty() && _events.top().time <= until) {
+      Event event = _events.top();
+      _events.pop();
+      if (event.time > _now) _now = event.time;
+      event.run();
+      dispatchInterrupts();
+    }
+  }
+}
+
+namespace ArduinoNative {
+  uint64_t now() { return _now; }
+
+  void advance(uint32_t us) {
+    uint64_t target = _now + us;
+    runEvents(target);
+    if (target > _now) _now = target; // an interrupt handler may already have moved past target
+    dispatchInterrupts();
+  }
+
+  void runUntil(uint64_t time) {
+    if (time > _now) advance(time - _now);
+  }
+
+  void schedule(uint64_t time, std::function<void()> event) {
+    _events.push(Event{ time < _now ? _now : time, _eventSeq++, event });
+  }
+
+  void attachSPIDevice(uint8_t csPin, SPIDevice* device) {
+    _spiDevice[csPin] = device;
+    _pinLevel[csPin] = HIGH;
+  }
+
+  void setPin(uint8_t pin, uint8_t level) {
+    uint8_t old = _pinLevel[pin];
+    _pinLevel[pin] = level;
+    for (uint8_t i = 0; i < NATIVE_INTERRUPTS; i++) {
+      Interrupt& irq = _interrupt[i];
+      if (interruptPin(i) != pin || irq.handler == nullptr || old == level) continue;
+      if (irq.mode == CHANGE || (irq.mode == RISING && level) || (irq.mode == FALLING && !level))
+        irq.pending = true;
+    }
+  }
+
+  void serialHostWrite(const char* text) { serialHostWrite((const uint8_t*)text, strlen(text)); }
+
+  void serialHostWrite(const uint8_t* data, uint16_t len) {
+    for (uint16_t i = 0; i < len; i++) _serialRx.push_back(data[i]);
+  }
+
+  void serialOnOutput(std::function<void(uint8_t)> sink) { _serialSink = sink; }
+
+  uint64_t serialBytesOut() { return _serialBytesOut; }
+}
+
+//=============================================================================
+// pins, time and interrupts
+//=============================================================================
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (pin >= NATIVE_PINS) return;
+  ArduinoNative::advance(NATIVE_COST_DIGITALIO_US);
+  uint8_t old = _pinLevel[pin];
+  _pinLevel[pin] = val ? HIGH : LOW;
+  SPIDevice* device = _spiDevice[pin];
+  if (device == nullptr || old == _pinLevel[pin]) return;
+  if (val == LOW) {
+    _spiSelected = device;
+    device->select();
+  } else {
+    device->unselect();
+    if (_spiSelected == device) _spiSelected = nullptr;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  ArduinoNative::advance(NATIVE_COST_DIGITALIO_US);
+  return pin < NATIVE_PINS ? _pinLevel[pin] : LOW;
+}
+
+int analogRead(uint8_t) { return 0; }
+void analogWrite(uint8_t, int) {}
+
+unsigned long millis(void) {
+  ArduinoNative::advance(NATIVE_COST_TIME_CALL_US);
+  return _now / 1000;
+}
+
+unsigned long micros(void) {
+  ArduinoNative::advance(NATIVE_COST_TIME_CALL_US);
+  return _now;
+}
+
+void delay(unsigned long ms) { ArduinoNative::advance(ms * 1000); }
+void delayMicroseconds(unsigned int us) { ArduinoNative::advance(us); }
+void yield(void) {}
+
+void attachInterrupt(uint8_t interruptNum, void (*userFunc)(void), int mode) {
+  if (interruptNum >= NATIVE_INTERRUPTS) return;
+  _interrupt[interruptNum].handler = userFunc;
+  _interrupt[interruptNum].mode = mode;
+  _interrupt[interruptNum].pending = false;
+}
+
+void detachInterrupt(uint8_t interruptNum) {
+  if (interruptNum >= NATIVE_INTERRUPTS) return;
+  _interrupt[interruptNum].handler = nullptr;
+  _interrupt[interruptNum].pending = false;
+}
+
+void interrupts(void) {
+  _interruptsEnabled = true;
+  dispatchInterrupts();
+}
+
+void noInterrupts(void) { _interruptsEnabled = false; }
+
+long random(long howbig) { return howbig <= 0 ? 0 : rand() % howbig; }
+long random(long howsmall, long howbig) { return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall); }
+void randomSeed(unsigned long seed) { srand(seed); }
+
+//=============================================================================
+// SPI
+//=============================================================================
+void SPIClass::usingInterrupt(uint8_t interruptNumber) {
+  if (interruptNumber < NATIVE_INTERRUPTS) _spiUsesInterrupt[interruptNumber] = true;
+}
+
+void SPIClass::notUsingInterrupt(uint8_t interruptNumber) {
+  if (interruptNumber < NATIVE_INTERRUPTS) _spiUsesInterrupt[interruptNumber] = false;
+}
+
+void SPIClass::beginTransaction(SPISettings) {
+  ArduinoNative::advance(NATIVE_COST_SPI_TRANSACTION_US);
+  if (_spiTransactionDepth++ == 0)
+    for (uint8_t i = 0; i < NATIVE_INTERRUPTS; i++) _interrupt[i].masked = _spiUsesInterrupt[i];
+}
+
+void SPIClass::endTransaction() {
+  if (_spiTransactionDepth > 0 && --_spiTransactionDepth == 0)
+    for (uint8_t i = 0; i < NATIVE_INTERRUPTS; i++) _interrupt[i].masked = false;
+  ArduinoNative::advance(NATIVE_COST_SPI_TRANSACTION_US);
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  ArduinoNative::advance(NATIVE_COST_SPI_BYTE_US);
+  return _spiSelected ? _spiSelected->transfer(data) : 0xFF;
+}
+
+uint16_t SPIClass::transfer16(uint16_t data) {
+  uint16_t result = transfer(data >> 8) << 8;
+  return result | transfer(data & 0xFF);
+}
+
+void SPIClass::transfer(void* buf, size_t count) {
+  uint8_t* p = (uint8_t*)buf;
+  for (size_t i = 0; i < count; i++) p[i] = transfer(p[i]);
+}
+
+//=============================================================================
+// Print / Stream / HardwareSerial
+//=============================================================================
+size_t Print::write(const uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (size--) n += write(*buffer++);
+  return n;
+}
+
+size_t Print::printNumber(unsigned long n, uint8_t base) {
+  char buf[8 * sizeof(long) + 1];
+  char* str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) base = 10;
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::print(long n, int base) {
+  if (base == 0) return write((uint8_t)n);
+  if (base == 10 && n < 0) return print('-') + printNumber(-n, 10);
+  return printNumber(n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  if (base == 0) return write((uint8_t)n);
+  return printNumber(n, base);
+}
+
+size_t Print::print(double number, int digits) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%.*f", digits, number);
+  return write(buf);
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) return c;
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+int Stream::timedPeek() {
+  unsigned long start = millis();
+  do {
+    int c = peek();
+    if (c >= 0) return c;
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+long Stream::parseInt() {
+  int c;
+  do { // skip leading characters that can't start a number
+    c = timedPeek();
+    if (c < 0) return 0;
+    if (c == '-' || (c >= '0' && c <= '9')) break;
+    read();
+  } while (true);
+
+  bool negative = false;
+  long value = 0;
+  do {
+    if (c == '-') negative = true;
+    else value = value * 10 + c - '0';
+    read();
+    c = timedPeek();
+  } while (c >= '0' && c <= '9');
+  return negative ? -value : value;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) break;
+    *buffer++ = (char)c;
+    count++;
+  }
+  return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length) {
+  size_t index = 0;
+  while (index < length) {
+    int c = timedRead();
+    if (c < 0 || c == terminator) break;
+    *buffer++ = (char)c;
+    index++;
+  }
+  return index;
+}
+
+int HardwareSerial::available() {
+  ArduinoNative::advance(NATIVE_COST_SERIAL_CALL_US);
+  return _serialRx.size();
+}
+
+int HardwareSerial::read() {
+  ArduinoNative::advance(NATIVE_COST_SERIAL_CALL_US);
+  if (_serialRx.empty()) return -1;
+  uint8_t c = _serialRx.front();
+  _serialRx.pop_front();
+  return c;
+}
+
+int HardwareSerial::peek() {
+  return _serialRx.empty() ? -1 : _serialRx.front();
+}
+
+// one start bit, eight data bits and one stop bit per byte
+static uint32_t serialByteTime(unsigned long baud) { return (10000000UL + baud - 1) / baud; }
+
+int HardwareSerial::availableForWrite() {
+  uint32_t byteTime = serialByteTime(_baud);
+  uint64_t backlog = _serialTxIdleAt > _now ? (_serialTxIdleAt - _now + byteTime - 1) / byteTime : 0;
+  return backlog >= NATIVE_SERIAL_TX_BUFFER ? 0 : NATIVE_SERIAL_TX_BUFFER - backlog;
+}
+
+void HardwareSerial::flush() {
+  ArduinoNative::runUntil(_serialTxIdleAt);
+}
+
+// blocks (ie. advances the clock) while the TX ring is full, like the AVR core
+size_t HardwareSerial::write(uint8_t c) {
+  ArduinoNative::advance(NATIVE_COST_SERIAL_CALL_US);
+  uint32_t byteTime = serialByteTime(_baud);
+  if (availableForWrite() == 0)
+    ArduinoNative::runUntil(_serialTxIdleAt - (NATIVE_SERIAL_TX_BUFFER - 1) * byteTime);
+  _serialTxIdleAt = (_serialTxIdleAt > _now ? _serialTxIdleAt : _now) + byteTime;
+  _serialBytesOut++;
+  if (_serialSink) _serialSink(c);
+  return 1;
+}
@@ -0,0 +1,49 @@
+// **********************************************************************************
+// Host side of the native Arduino core used by the [env:native] simulation build
+// **********************************************************************************
+// Everything the sketch sees as "hardware" runs on one simulated microsecond clock:
+// - every core call (millis(), digitalWrite(), SPI.transfer(), Serial.write() ...)
+//   charges its rough ATmega328P cost to the clock and processes due events
+// - device models (radio, flash) hang off the SPI bus by their CS pin and can
+//   drive input pins, which fires attached interrupts like the real INT0/INT1
+// - the host feeds the sketch's Serial RX and taps its Serial TX
+// **********************************************************************************
+#ifndef ArduinoNative_h
+#define ArduinoNative_h
+#include <stdint.h>
+#include <functional>
+
+// Cost in microseconds charged to the simulated clock by each core primitive,
+// roughly what a 16MHz ATmega328P spends on the same call
+#define NATIVE_COST_TIME_CALL_US      2 // millis()/micros()
+#define NATIVE_COST_DIGITALIO_US      3 // digitalWrite()/digitalRead()
+#define NATIVE_COST_SPI_BYTE_US       1 // one byte at SPI_CLOCK_DIV2
+#define NATIVE_COST_SPI_TRANSACTION_US 1 // beginTransaction()/endTransaction()
+#define NATIVE_COST_SERIAL_CALL_US    2 // Serial.available()/read()/write()
+#define NATIVE_SERIAL_TX_BUFFER      64 // HardwareSerial TX ring size on AVR
+
+// A device sitting on the simulated SPI bus, selected by pulling its CS pin low
+class SPIDevice {
+  public:
+    virtual ~SPIDevice() {}
+    virtual void select() {}
+    virtual uint8_t transfer(uint8_t out) = 0;
+    virtual void unselect() {}
+};
+
+namespace ArduinoNative {
+  uint64_t now(); // simulated time in microseconds
+  void advance(uint32_t us); // move the clock forward, running due events and pending interrupts
+  void runUntil(uint64_t time);
+  void schedule(uint64_t time, std::function<void()> event);
+
+  void attachSPIDevice(uint8_t csPin, SPIDevice* device);
+  void setPin(uint8_t pin, uint8_t level); // drive an input pin from a device model
+
+  void serialHostWrite(const char* text); // bytes the sketch will read from Serial
+  void serialHostWrite(const uint8_t* data, uint16_t len);
+  void serialOnOutput(std::function<void(uint8_t)> sink); // bytes the sketch wrote to Serial
+  uint64_t serialBytesOut();
+}
+
+#endif
@@ -0,0 +1,81 @@
+// **********************************************************************************
+// Native (host) Print/Stream/HardwareSerial, same overload set as the AVR core so
+// that calls like Serial.print((char)x, HEX) resolve the same way on both targets
+// **********************************************************************************
+#ifndef Print_h
+#define Print_h
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class __FlashStringHelper;
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size);
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+
+    size_t print(const __FlashStringHelper* ifsh) { return print(reinterpret_cast<const char*>(ifsh)); }
+    size_t print(const char str[]) { return write(str); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char b, int base = DEC) { return print((unsigned long)b, base); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(const __FlashStringHelper* ifsh) { return print(ifsh) + println(); }
+    size_t println(const char c[]) { return print(c) + println(); }
+    size_t println(char c) { return print(c) + println(); }
+    size_t println(unsigned char b, int base = DEC) { return print(b, base) + println(); }
+    size_t println(int num, int base = DEC) { return print(num, base) + println(); }
+    size_t println(unsigned int num, int base = DEC) { return print(num, base) + println(); }
+    size_t println(long num, int base = DEC) { return print(num, base) + println(); }
+    size_t println(unsigned long num, int base = DEC) { return print(num, base) + println(); }
+    size_t println(double num, int digits = 2) { return print(num, digits) + println(); }
+    size_t println(void) { return write("\r\n"); }
+
+  private:
+    size_t printNumber(unsigned long n, uint8_t base);
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    long parseInt(); // skips anything that is not a digit or '-', waits up to the timeout for more
+    size_t readBytes(char* buffer, size_t length);
+    size_t readBytesUntil(char terminator, char* buffer, size_t length);
+
+  protected:
+    int timedRead();
+    int timedPeek();
+    unsigned long _timeout = 1000;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin(unsigned long baud) { _baud = baud; }
+    void end() {}
+    int available();
+    int read();
+    int peek();
+    int availableForWrite();
+    void flush();
+    size_t write(uint8_t c);
+    using Print::write;
+    operator bool() { return true; }
+
+    unsigned long _baud = 9600;
+};
+
+extern HardwareSerial Serial;
+
+#endif
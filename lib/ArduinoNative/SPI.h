@@ -0,0 +1,55 @@
+// **********************************************************************************
+// Native (host) SPI: a single bus that routes each byte to the SPIDevice whose CS
+// pin is currently held LOW (see ArduinoNative::attachSPIDevice())
+// **********************************************************************************
+#ifndef _SPI_H_INCLUDED
+#define _SPI_H_INCLUDED
+#include <Arduino.h>
+
+#define SPI_HAS_TRANSACTION 1
+
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+#define SPI_CLOCK_DIV2   0x04
+#define SPI_CLOCK_DIV4   0x00
+#define SPI_CLOCK_DIV8   0x05
+#define SPI_CLOCK_DIV16  0x01
+
+#ifndef LSBFIRST
+#define LSBFIRST 0
+#endif
+#ifndef MSBFIRST
+#define MSBFIRST 1
+#endif
+
+class SPISettings {
+  public:
+    SPISettings(uint32_t clock = 4000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+      : _clock(clock), _bitOrder(bitOrder), _dataMode(dataMode) {}
+    uint32_t _clock;
+    uint8_t _bitOrder;
+    uint8_t _dataMode;
+};
+
+class SPIClass {
+  public:
+    void begin() {}
+    void end() {}
+    void usingInterrupt(uint8_t interruptNumber); // masks it between beginTransaction() and endTransaction()
+    void notUsingInterrupt(uint8_t interruptNumber);
+    void beginTransaction(SPISettings settings);
+    void endTransaction();
+    uint8_t transfer(uint8_t data);
+    uint16_t transfer16(uint16_t data);
+    void transfer(void* buf, size_t count);
+    void setBitOrder(uint8_t) {}
+    void setDataMode(uint8_t) {}
+    void setClockDivider(uint8_t) {}
+};
+
+extern SPIClass SPI;
+
+#endif
@@ -0,0 +1,2 @@
+// Native (host) stand-in, see Arduino.h
+#include "Arduino.h"
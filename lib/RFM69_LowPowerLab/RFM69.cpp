@@ -27,16 +27,7 @@
 #include "RFM69registers.h"
 #include <SPI.h>
 
-uint8_t RFM69::DATA[RF69_MAX_DATA_LEN+1];
-uint8_t RFM69::_mode;        // current transceiver state
-uint8_t RFM69::DATALEN;
-uint16_t RFM69::SENDERID;
-uint16_t RFM69::TARGETID;     // should match _address
-uint8_t RFM69::PAYLOADLEN;
-uint8_t RFM69::ACK_REQUESTED;
-uint8_t RFM69::ACK_RECEIVED; // should be polled immediately after sending a packet with ACK request
-int16_t RFM69::RSSI;          // most accurate RSSI during reception (closest to the reception)
-volatile bool RFM69::_haveData;
+RFM69* RFM69::_isrRadios[RF69_MAX_RADIOS];
 
 RFM69::RFM69(uint8_t slaveSelectPin, uint8_t interruptPin, bool isRFM69HW_HCW, SPIClass *spi) {
   _slaveSelectPin = slaveSelectPin;
@@ -44,8 +35,39 @@ RFM69::RFM69(uint8_t slaveSelectPin, uint8_t interruptPin, bool isRFM69HW_HCW, S
   _mode = RF69_MODE_STANDBY;
   _spyMode = false;
   _powerLevel = 31;
+  _profile = RF69_PROFILE_55KBPS;
+  memset(_shadow, 0, sizeof(_shadow));
+#if defined(RF69_SHADOW_VERIFY)
+  _shadowMismatches = 0;
+#endif
   _isRFM69HW = isRFM69HW_HCW;
   _spi = spi;
+  _txHead = 0;
+  _txCount = 0;
+  _txHold = false;
+  _txState = RF69_TX_IDLE;
+  _txStamped = false;
+  _rxHead = 0;
+  _rxTail = 0;
+  _rxHeld = false;
+  memset(&_stats, 0, sizeof(_stats));
+  _airPeriodStart = 0;
+  _csmaMinBE = RF69_CSMA_MIN_BE;
+  _csmaMaxBE = RF69_CSMA_MAX_BE;
+  _csmaSlotUs = RF69_CSMA_SLOT_US;
+  _backoffSeed = 1;
+  _airTxUs = _airRxUs = 0;
+  _airLastTxUs = _airLastRxUs = 0;
+  DATALEN = 0;
+  SENDERID = 0;
+  TARGETID = 0;
+  PAYLOADLEN = 0;
+  ACK_REQUESTED = 0;
+  ACK_RECEIVED = 0;
+  RSSI = 0;
+  _haveData = false;
+  _packetSent = false;
+  _packetSentMicros = 0;
 #if defined(RF69_LISTENMODE_ENABLE)
   _isHighSpeed = true;
   _haveEncryptKey = false;
@@ -127,9 +149,11 @@ bool RFM69::initialize(uint8_t freqBand, uint16_t nodeID, uint8_t networkID)
   do writeReg(REG_SYNCVALUE1, 0xAA); while (readReg(REG_SYNCVALUE1) != 0xaa && millis()-start < timeout);
   start = millis();
   do writeReg(REG_SYNCVALUE1, 0x55); while (readReg(REG_SYNCVALUE1) != 0x55 && millis()-start < timeout);
+  if (millis()-start >= timeout)
+    return false; // no radio on this CS pin, e.g. an optional second one that isn't fitted
 
-  for (uint8_t i = 0; CONFIG[i][0] != 255; i++)
-    writeReg(CONFIG[i][0], CONFIG[i][1]);
+  writeRegTable(CONFIG);
+  loadShadow(); // picks up the reset values of the shadowed registers CONFIG doesn't set
 
   // Encryption is persistent between resets and can trip you up during debugging.
   // Disable it during initialization so we always start from a known state.
@@ -141,9 +165,16 @@ bool RFM69::initialize(uint8_t freqBand, uint16_t nodeID, uint8_t networkID)
   while (((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00) && millis()-start < timeout); // wait for ModeReady
   if (millis()-start >= timeout)
     return false;
-  attachInterrupt(_interruptNum, RFM69::isr0, RISING);
+#ifdef SPI_HAS_TRANSACTION
+  _spi->usingInterrupt(_interruptNum); // isr0() talks to the radio, keep it out of other SPI transactions
+#endif
+  if (!attachIsr())
+    return false;
 
   _address = nodeID;
+  // nodes that power up together must still draw different backoffs
+  _backoffSeed ^= (nodeID << 5) ^ (uint16_t)micros() ^ (uint8_t)readRSSI();
+  if (_backoffSeed == 0) _backoffSeed = nodeID | 1;
 #if defined(RF69_LISTENMODE_ENABLE)
   selfPointer = this;
   _freqBand = freqBand;
@@ -155,7 +186,7 @@ bool RFM69::initialize(uint8_t freqBand, uint16_t nodeID, uint8_t networkID)
 // return the frequency (in Hz)
 uint32_t RFM69::getFrequency()
 {
-  return RF69_FSTEP * (((uint32_t) readReg(REG_FRFMSB) << 16) + ((uint16_t) readReg(REG_FRFMID) << 8) + readReg(REG_FRFLSB));
+  return RF69_FSTEP * (((uint32_t) shadowReg(REG_FRFMSB) << 16) + ((uint16_t) shadowReg(REG_FRFMID) << 8) + shadowReg(REG_FRFLSB));
 }
 
 // set the frequency (in Hz)
@@ -166,9 +197,8 @@ void RFM69::setFrequency(uint32_t freqHz)
     setMode(RF69_MODE_RX);
   }
   freqHz /= RF69_FSTEP; // divide down by FSTEP to get FRF
-  writeReg(REG_FRFMSB, freqHz >> 16);
-  writeReg(REG_FRFMID, freqHz >> 8);
-  writeReg(REG_FRFLSB, freqHz);
+  uint8_t frf[3] = { (uint8_t)(freqHz >> 16), (uint8_t)(freqHz >> 8), (uint8_t)freqHz };
+  writeRegs(REG_FRFMSB, frf, sizeof(frf)); // FRF takes effect on the LSB, the last byte written
   if (oldMode == RF69_MODE_RX) {
     setMode(RF69_MODE_SYNTH);
   }
@@ -177,36 +207,36 @@ void RFM69::setFrequency(uint32_t freqHz)
 
 void RFM69::setMode(uint8_t newMode)
 {
-  if (newMode == _mode)
+  uint8_t oldMode = _mode;
+  if (newMode == oldMode || newMode > RF69_MODE_TX)
     return;
 
+  // isr() goes by _mode, so it changes before the radio does: once a frame is on the
+  // air its PacketSent interrupt must never find the old mode
+  _mode = newMode;
   switch (newMode) {
     case RF69_MODE_TX:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_TRANSMITTER);
+      writeReg(REG_OPMODE, (shadowReg(REG_OPMODE) & 0xE3) | RF_OPMODE_TRANSMITTER);
       if (_isRFM69HW) setHighPowerRegs(true);
       break;
     case RF69_MODE_RX:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_RECEIVER);
+      writeReg(REG_OPMODE, (shadowReg(REG_OPMODE) & 0xE3) | RF_OPMODE_RECEIVER);
       if (_isRFM69HW) setHighPowerRegs(false);
       break;
     case RF69_MODE_SYNTH:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SYNTHESIZER);
+      writeReg(REG_OPMODE, (shadowReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SYNTHESIZER);
       break;
     case RF69_MODE_STANDBY:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_STANDBY);
+      writeReg(REG_OPMODE, (shadowReg(REG_OPMODE) & 0xE3) | RF_OPMODE_STANDBY);
       break;
     case RF69_MODE_SLEEP:
-      writeReg(REG_OPMODE, (readReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SLEEP);
+      writeReg(REG_OPMODE, (shadowReg(REG_OPMODE) & 0xE3) | RF_OPMODE_SLEEP);
       break;
-    default:
-      return;
   }
 
   // we are using packet mode, so this check is not really needed
   // but waiting for mode ready is necessary when going from sleep because the FIFO may not be immediately available from previous mode
-  while (_mode == RF69_MODE_SLEEP && (readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
-
-  _mode = newMode;
+  while (oldMode == RF69_MODE_SLEEP && (readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
 }
 
 //put transceiver in sleep mode to save battery - to wake or resume receiving just call receiveDone()
@@ -294,7 +324,7 @@ int8_t RFM69::setPowerDBm(int8_t dBm) {
 
 bool RFM69::canSend() 
 {
-  if (_mode == RF69_MODE_RX && PAYLOADLEN == 0 && readRSSI() < CSMA_LIMIT) // if signal stronger than -100dBm is detected assume channel activity
+  if (_mode == RF69_MODE_RX && readRSSI() < CSMA_LIMIT) // if signal stronger than -100dBm is detected assume channel activity
   {
     setMode(RF69_MODE_STANDBY);
     return true;
@@ -302,14 +332,38 @@ bool RFM69::canSend()
   return false;
 }
 
+// false if the exponents are out of range (minBE <= maxBE <= RF69_CSMA_BE_LIMIT) or slotUs is 0
+bool RFM69::setCsmaBackoff(uint8_t minBE, uint8_t maxBE, uint16_t slotUs)
+{
+  if (minBE > maxBE || maxBE > RF69_CSMA_BE_LIMIT || slotUs == 0) return false;
+  _csmaMinBE = minBE;
+  _csmaMaxBE = maxBE;
+  _csmaSlotUs = slotUs;
+  return true;
+}
+
 void RFM69::send(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK)
 {
-  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-  uint32_t now = millis();
-  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
+  waitForChannel(_csmaMinBE);
   sendFrame(toAddress, buffer, bufferSize, requestACK, false);
 }
 
+// queue a frame and return immediately; receiveDone() waits for a clear channel and sends it
+// in the background. Returns false if the queue is full or the payload is too big for a slot.
+// With stamp, txStamp() reports when the frame finished transmitting (e.g. for time sync)
+bool RFM69::sendAsync(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool stamp)
+{
+  if (_txCount >= RF69_TX_QUEUE_LEN || bufferSize > RF69_TX_QUEUE_DATA_LEN) return false;
+  TxFrame& frame = _txQueue[(_txHead + _txCount) % RF69_TX_QUEUE_LEN];
+  frame.toAddress = toAddress;
+  frame.size = bufferSize;
+  frame.requestACK = requestACK;
+  frame.stamp = stamp;
+  memcpy(frame.data, buffer, bufferSize);
+  _txCount++;
+  return true;
+}
+
 // to increase the chance of getting a packet across, call this function instead of send
 // and it handles all the ACK requesting/retrying for you :)
 // The only twist is that you have to manually listen to ACK requests on the other side and send back the ACKs
@@ -324,9 +378,14 @@ bool RFM69::sendWithRetry(uint16_t toAddress, const void* buffer, uint8_t buffer
     sentTime = millis();
     while (millis() - sentTime < retryWaitTime)
     {
-      if (ACKReceived(toAddress)) return true;
+      if (ACKReceived(toAddress))
+      {
+        countAck(i, sentTime);
+        return true;
+      }
     }
   }
+  _stats.retryFailures++;
   return false;
 }
 
@@ -347,21 +406,160 @@ void RFM69::sendACK(const void* buffer, uint8_t bufferSize) {
   ACK_REQUESTED = 0;   // TWS added to make sure we don't end up in a timing race and infinite loop sending Acks
   uint16_t sender = SENDERID;
   int16_t _RSSI = RSSI; // save payload received RSSI value
-  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-  uint32_t now = millis();
-  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
-  SENDERID = sender;    // TWS: Restore SenderID after it gets wiped out by receiveDone()
+  waitForChannel(RF69_CSMA_ACK_BE);
+  SENDERID = sender;    // TWS: Restore SenderID after it gets wiped out by receiveBegin()
   sendFrame(sender, buffer, bufferSize, false, true);
   RSSI = _RSSI; // restore payload RSSI
 }
 
 // internal function
 void RFM69::sendFrame(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK)
+{
+  //NOTE: overridden in RFM69_ATC!
+  startFrame(toAddress, buffer, bufferSize, requestACK, sendACK);
+  uint32_t txStart = millis();
+  while (!_packetSent && millis() - txStart < RF69_TX_LIMIT_MS); // isr0() puts the radio in standby when DIO0 signals PacketSent
+  if (!_packetSent) _stats.txTimeouts++;
+  setMode(RF69_MODE_STANDBY);
+}
+
+// internal function - carrier sense for the blocking send()/sendACK(): back off until the
+// channel is clear or RF69_CSMA_LIMIT_MS runs out. Frames keep arriving in the meantime
+void RFM69::waitForChannel(uint8_t minBE)
+{
+  rxRestartIdle();
+  uint32_t now = millis();
+  RFM69Backoff backoff;
+  backoffStart(backoff, minBE);
+  bool clear;
+  while (!(clear = backoffClear(backoff)) && millis() - now < RF69_CSMA_LIMIT_MS) listen();
+  countCsma(now, clear);
+}
+
+// internal function - draw the first wait of a frame, 0 to 2^exponent-1 slots
+void RFM69::backoffStart(RFM69Backoff& backoff, uint8_t exponent)
+{
+  backoff.exponent = exponent;
+  backoff.slots = backoffRandom() & ((1U << exponent) - 1);
+  backoff.slotStart = micros();
+}
+
+// internal function - true once the wait is over and a listen finds the channel clear (the
+// radio is then in standby, like after canSend()). A busy listen doubles the window and
+// draws again, at least one slot so a busy channel is sampled once per slot at most
+bool RFM69::backoffClear(RFM69Backoff& backoff)
+{
+  while (backoff.slots && micros() - backoff.slotStart >= _csmaSlotUs) {
+    backoff.slots--;
+    backoff.slotStart += _csmaSlotUs;
+  }
+  if (backoff.slots || _mode != RF69_MODE_RX) return false;
+  if (canSend()) return true;
+  _stats.csmaBusy++;
+  if (backoff.exponent < _csmaMaxBE) backoff.exponent++;
+  backoff.slots = 1 + (backoffRandom() & ((1U << backoff.exponent) - 1));
+  backoff.slotStart = micros();
+  return false;
+}
+
+// internal function - xorshift16, the sketch's random() sequence is left alone
+uint16_t RFM69::backoffRandom()
+{
+  _backoffSeed ^= _backoffSeed << 7;
+  _backoffSeed ^= _backoffSeed >> 9;
+  _backoffSeed ^= _backoffSeed << 8;
+  return _backoffSeed;
+}
+
+// internal function - stats for one frame that waited for the channel since startMs
+void RFM69::countCsma(uint32_t startMs, bool clear)
+{
+  if (!clear) _stats.csmaTimeouts++;
+  _stats.csmaWait[statsBucket(millis() - startMs)]++;
+}
+
+// internal function - stats for a sendWithRetry() ACKed after retries, whose last try ended at sentMs
+void RFM69::countAck(uint8_t retries, uint32_t sentMs)
+{
+  _stats.ackRtt[statsBucket(millis() - sentMs)]++;
+  _stats.retries[retries < RF69_STATS_RETRIES ? retries : RF69_STATS_RETRIES - 1]++;
+}
+
+// internal function - stats for one frame on the air, from isr0(): payloadLen bytes after the header
+void RFM69::countAirtime(uint8_t payloadLen, bool tx)
+{
+  uint32_t us = airtimeUs(payloadLen);
+  rollAirtime(millis());
+  if (tx) {
+    _stats.txAirtimeUs += us;
+    _airTxUs += us;
+  }
+  else {
+    _stats.rxAirtimeUs += us;
+    _airRxUs += us;
+  }
+}
+
+// internal function - start a new airtime period once the current one is over; after a
+// quiet spell longer than a period the last period had no traffic at all
+void RFM69::rollAirtime(uint32_t now)
+{
+  uint32_t elapsed = now - _airPeriodStart;
+  if (elapsed < RF69_AIRTIME_PERIOD_MS) return;
+  bool justEnded = elapsed < 2 * RF69_AIRTIME_PERIOD_MS;
+  _airLastTxUs = justEnded ? _airTxUs : 0;
+  _airLastRxUs = justEnded ? _airRxUs : 0;
+  _airTxUs = _airRxUs = 0;
+  _airPeriodStart = now - elapsed % RF69_AIRTIME_PERIOD_MS;
+}
+
+// airtime sent and received in the last whole RF69_AIRTIME_PERIOD_MS, divide by
+// RF69_AIRTIME_PERIOD_MS for the channel use in per mille
+void RFM69::lastAirtime(uint32_t& txUs, uint32_t& rxUs)
+{
+  noInterrupts();
+  rollAirtime(millis());
+  txUs = _airLastTxUs;
+  rxUs = _airLastRxUs;
+  interrupts();
+}
+
+// histogram bucket of a time in ms: 0 under 1ms, then n for 2^(n-1) up to 2^n ms, the last open ended
+uint8_t RFM69::statsBucket(uint32_t ms)
+{
+  uint8_t bucket = 0;
+  while (ms && bucket < RF69_STATS_BUCKETS - 1) {
+    ms >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+// copy the counters with interrupts off, so isr0() can't change them half way through
+void RFM69::readStats(RFM69Stats& stats, bool reset)
+{
+  noInterrupts();
+  stats = _stats;
+  if (reset) memset(&_stats, 0, sizeof(_stats));
+  interrupts();
+}
+
+// read with interrupts off like readStats(), isr0() counts the drops
+uint16_t RFM69::rxDropped()
+{
+  noInterrupts();
+  uint16_t dropped = _stats.rxDropped;
+  interrupts();
+  return dropped;
+}
+
+// internal function - fill the FIFO and start transmitting, without waiting for PacketSent
+void RFM69::startFrame(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK)
 {
   //NOTE: overridden in RFM69_ATC!
   setMode(RF69_MODE_STANDBY); // turn off receiver to prevent reception while filling fifo
   while ((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
-  //writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00); // DIO0 is "Packet Sent"
+  writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00); // DIO0 is "Packet Sent"
   if (bufferSize > RF69_MAX_DATA_LEN) bufferSize = RF69_MAX_DATA_LEN;
 
   // control byte
@@ -375,67 +573,105 @@ void RFM69::sendFrame(uint16_t toAddress, const void* buffer, uint8_t bufferSize
   if (_address > 0xFF) CTLbyte |= (_address & 0x300) >> 8;   //assign last 2 bits of address if > 255
 
   // write to FIFO
+  uint8_t header[5] = { REG_FIFO | 0x80, (uint8_t)(bufferSize + 3), (uint8_t)toAddress, (uint8_t)_address, CTLbyte };
+  _txLen = bufferSize;
   select();
-  _spi->transfer(REG_FIFO | 0x80);
-  _spi->transfer(bufferSize + 3);
-  _spi->transfer((uint8_t)toAddress);
-  _spi->transfer((uint8_t)_address);
-  _spi->transfer(CTLbyte);
-
-  for (uint8_t i = 0; i < bufferSize; i++)
-    _spi->transfer(((uint8_t*) buffer)[i]);
+  spiWrite(header, sizeof(header));
+  spiWrite(buffer, bufferSize);
   unselect();
 
   // no need to wait for transmit mode to be ready since its handled by the radio
+  _packetSent = false;
   setMode(RF69_MODE_TX);
-  //uint32_t txStart = millis();
-  //while (digitalRead(_interruptPin) == 0 && millis() - txStart < RF69_TX_LIMIT_MS); // wait for DIO0 to turn HIGH signalling transmission finish
-  while ((readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PACKETSENT) == 0x00); // wait for PacketSent
-  setMode(RF69_MODE_STANDBY);
 }
 
-// internal function - interrupt gets called when a packet is received
+// internal function - called from isr0() when a packet is received: drain the FIFO into the
+// receive queue and go straight back to RX, the sketch picks the frame up with receiveNext()
 void RFM69::interruptHandler() {
   if (_mode == RF69_MODE_RX && (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY))
   {
+    int16_t rssi = readRSSI(); // still the level of this packet, the receiver hasn't restarted yet
     setMode(RF69_MODE_STANDBY);
+    uint8_t header[5] = { REG_FIFO & 0x7F }; // comes back as the FIFO address byte then len, target, sender, CTL
     select();
-    _spi->transfer(REG_FIFO & 0x7F);
-    PAYLOADLEN = _spi->transfer(0);
-    PAYLOADLEN = PAYLOADLEN > 66 ? 66 : PAYLOADLEN; // precaution
-    TARGETID = _spi->transfer(0);
-    SENDERID = _spi->transfer(0);
-    uint8_t CTLbyte = _spi->transfer(0);
-    TARGETID |= (uint16_t(CTLbyte) & 0x0C) << 6; //10 bit address (most significant 2 bits stored in bits(2,3) of CTL byte
-    SENDERID |= (uint16_t(CTLbyte) & 0x03) << 8; //10 bit address (most sifnigicant 2 bits stored in bits(0,1) of CTL byte
-
-    if(!(_spyMode || TARGETID == _address || TARGETID == RF69_BROADCAST_ADDR) // match this node's address, or broadcast address or anything in spy mode
-       || PAYLOADLEN < 3) // address situation could receive packets that are malformed and don't fit this libraries extra fields
+    _spi->transfer(header, sizeof(header));
+    uint8_t payloadLen = header[1] > 66 ? 66 : header[1]; // precaution
+    uint16_t targetId = header[2];
+    uint16_t senderId = header[3];
+    uint8_t CTLbyte = header[4];
+    targetId |= (uint16_t(CTLbyte) & 0x0C) << 6; //10 bit address (most significant 2 bits stored in bits(2,3) of CTL byte
+    senderId |= (uint16_t(CTLbyte) & 0x03) << 8; //10 bit address (most sifnigicant 2 bits stored in bits(0,1) of CTL byte
+
+    bool forUs = _spyMode || targetId == _address || targetId == RF69_BROADCAST_ADDR; // match this node's address, or broadcast address or anything in spy mode
+    bool wellFormed = payloadLen >= 3 && payloadLen - 3 <= RF69_MAX_DATA_LEN;      // address situation could receive packets that are malformed and don't fit this libraries extra fields
+    bool keep = forUs && wellFormed;
+    countAirtime(payloadLen < RF69_HEADER_BYTES ? 0 : payloadLen - RF69_HEADER_BYTES, false); // it held the channel either way
+    if (!wellFormed) _stats.badFrames++;
+    else if (!forUs) _stats.addressFiltered++;
+    if (keep && (uint8_t)(_rxTail - _rxHead) >= RF69_RX_QUEUE_LEN)
     {
-      PAYLOADLEN = 0;
-      unselect();
-      receiveBegin();
-      return;
+      _stats.rxDropped++; // sketch is behind, every slot is still waiting to be read
+      keep = false;
     }
 
-    DATALEN = PAYLOADLEN - 3;
-    ACK_RECEIVED = CTLbyte & RFM69_CTL_SENDACK; // extract ACK-received flag
-    ACK_REQUESTED = CTLbyte & RFM69_CTL_REQACK; // extract ACK-requested flag
-    uint8_t _pl = _powerLevel; //interruptHook() can change _powerLevel so remember it
-    interruptHook(CTLbyte);    // TWS: hook to derived class interrupt function
-
-    for (uint8_t i = 0; i < DATALEN; i++) DATA[i] = _spi->transfer(0);
-
-    DATA[DATALEN] = 0; // add null at end of string // add null at end of string
+    if (keep)
+    {
+      RFM69Frame& frame = _rxQueue[_rxTail % RF69_RX_QUEUE_LEN];
+      frame.senderId = senderId;
+      frame.targetId = targetId;
+      frame.ctl = CTLbyte;
+      frame.len = payloadLen - 3;
+      frame.rssi = rssi;
+      frame.micros = micros();
+      _spi->transfer(frame.data, frame.len); // the FIFO ignores MOSI on reads, whatever was in the slot goes out
+    }
     unselect();
+    if (keep)
+    {
+      _rxTail++; // publish only once the slot is complete
+      _stats.framesReceived++;
+    }
+    else if (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)
+      rxRestartFromIsr(); // drop the unread rest
     setMode(RF69_MODE_RX);
-    if (_pl != _powerLevel) setPowerLevel(_powerLevel); //set new _powerLevel if changed
   }
-  RSSI = readRSSI();
 }
 
-// internal function
-ISR_PREFIX void RFM69::isr0() { _haveData = true; }
+// internal function - in TX, DIO0 is PacketSent: finish the transmit right here so the
+// transmitter is off before loop() gets around to it; otherwise it's PayloadReady and the
+// frame is queued right away, so nothing is lost while loop() is busy
+void RFM69::isr() {
+  if (_mode == RF69_MODE_TX) packetSentHandler();
+  else interruptHandler();
+}
+
+// internal function - attachInterrupt() takes a plain function, so each ISR slot gets its own
+ISR_PREFIX void RFM69::isr0() { _isrRadios[0]->isr(); }
+ISR_PREFIX void RFM69::isr1() { _isrRadios[1]->isr(); }
+
+// internal function - claim an ISR slot (keeping the one this instance already has) and hook
+// it to this radio's DIO0; false once RF69_MAX_RADIOS other instances hold them all
+bool RFM69::attachIsr() {
+  static void (*const handlers[RF69_MAX_RADIOS])() = { RFM69::isr0, RFM69::isr1 };
+  uint8_t slot = RF69_MAX_RADIOS;
+  for (uint8_t i = 0; i < RF69_MAX_RADIOS; i++) {
+    if (_isrRadios[i] == this) { slot = i; break; }
+    if (_isrRadios[i] == nullptr && slot == RF69_MAX_RADIOS) slot = i;
+  }
+  if (slot == RF69_MAX_RADIOS) return false;
+  _isrRadios[slot] = this;
+  attachInterrupt(_interruptNum, handlers[slot], RISING);
+  return true;
+}
+
+// internal function - called from isr0(), SPI is safe here thanks to usingInterrupt()
+void RFM69::packetSentHandler() {
+  setMode(RF69_MODE_STANDBY);
+  _packetSentMicros = micros(); // the last bit just left, as close to the air as the sketch can get
+  _packetSent = true;
+  _stats.framesSent++;
+  countAirtime(_txLen, true);
+}
 
 // internal function
 void RFM69::receiveBegin() {
@@ -450,28 +686,104 @@ void RFM69::receiveBegin() {
 #endif
   RSSI = 0;
   if (readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PAYLOADREADY)
-    writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
+    rxRestart(); // avoid RX deadlocks
   writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01); // set DIO0 to "PAYLOADREADY" in receive mode
   setMode(RF69_MODE_RX);
 }
 
 // checks if a packet was received and/or puts transceiver in receive (ie RX or listen) mode
+// the packet is loaded into DATA, SENDERID, RSSI etc. like it always was
 bool RFM69::receiveDone() {
-  if (_haveData) {
-  	_haveData = false;
-  	interruptHandler();
+  return receiveNext() != NULL;
+}
+
+// pops the oldest received frame, or returns NULL if there is none. The frame is also loaded
+// into DATA, SENDERID, RSSI etc. and stays valid until the next receiveNext()/receiveDone()
+const RFM69Frame* RFM69::receiveNext() {
+  if (_rxHeld) // the sketch is done with the previous frame, hand its slot back to isr0()
+  {
+    _rxHeld = false;
+    _rxHead++;
   }
-  if (_mode == RF69_MODE_RX && PAYLOADLEN > 0)
+  listen();
+  if (_rxHead == _rxTail) return NULL;
+
+  RFM69Frame& frame = _rxQueue[_rxHead % RF69_RX_QUEUE_LEN];
+  _rxHeld = true;
+  uint8_t _pl = _powerLevel; //interruptHook() can change _powerLevel so remember it
+  interruptHook(frame);      // TWS: hook to derived class interrupt function
+
+  SENDERID = frame.senderId;
+  TARGETID = frame.targetId;
+  PAYLOADLEN = frame.len + 3;
+  DATALEN = frame.len;
+  ACK_RECEIVED = frame.ctl & RFM69_CTL_SENDACK; // extract ACK-received flag
+  ACK_REQUESTED = frame.ctl & RFM69_CTL_REQACK; // extract ACK-requested flag
+  RSSI = frame.rssi;
+  memcpy(DATA, frame.data, DATALEN);
+  DATA[DATALEN] = 0; // add null at end of string
+  if (_pl != _powerLevel) setPowerLevel(_powerLevel); //set new _powerLevel if changed
+  return &frame;
+}
+
+// number of received frames waiting for receiveNext()
+uint8_t RFM69::rxQueued() {
+  return (uint8_t)(_rxTail - _rxHead) - (_rxHeld ? 1 : 0);
+}
+
+// internal function - keep the receiver listening and the sendAsync() queue moving, without
+// consuming received frames (safe to call from CSMA wait loops)
+void RFM69::listen() {
+  if (!txPoll() && _mode != RF69_MODE_RX) receiveBegin();
+}
+
+// true once for each frame queued with stamp that was actually sent (not timed out), with
+// the micros() at which its PacketSent interrupt fired. Only the latest one is kept
+bool RFM69::txStamp(uint32_t& txMicros) {
+  if (!_txStamped) return false;
+  _txStamped = false;
+  txMicros = _txStampMicros;
+  return true;
+}
+
+// internal function - advance the sendAsync() queue by one step without blocking.
+// Carrier sense needs RX mode, so a waiting frame only moves on while the receiver is listening.
+// Returns true while a queued frame is being transmitted
+bool RFM69::txPoll() {
+  if (_txState == RF69_TX_SENDING)
   {
-    setMode(RF69_MODE_STANDBY); // enables interrupts
-    return true;
+    if (!_packetSent && millis() - _txStart < RF69_TX_LIMIT_MS)
+      return true;
+    if (!_packetSent) _stats.txTimeouts++;
+    setMode(RF69_MODE_STANDBY); // no-op unless the transmit timed out
+    if (_packetSent && _txQueue[_txHead].stamp)
+    {
+      _txStampMicros = _packetSentMicros;
+      _txStamped = true;
+    }
+    _txHead = (_txHead + 1) % RF69_TX_QUEUE_LEN;
+    _txCount--;
+    _txState = RF69_TX_IDLE;
+    return false; // listen() goes back to RX
   }
-  else if (_mode == RF69_MODE_RX) // already in RX no payload yet
+  if (_txCount == 0 || _mode != RF69_MODE_RX || _txHold) return false;
+
+  if (_txState == RF69_TX_IDLE)
   {
-    return false;
+    rxRestartIdle();
+    _txStart = millis();
+    _txState = RF69_TX_CSMA;
+    backoffStart(_txBackoff, _csmaMinBE);
   }
-  receiveBegin();
-  return false;
+  bool clear = backoffClear(_txBackoff);
+  if (!clear && millis() - _txStart < RF69_CSMA_LIMIT_MS) return false; // like send(), give up waiting after the limit
+  countCsma(_txStart, clear);
+
+  TxFrame& frame = _txQueue[_txHead];
+  startFrame(frame.toAddress, frame.data, frame.size, frame.requestACK, false);
+  _txStart = millis();
+  _txState = RF69_TX_SENDING;
+  return true;
 }
 
 // To enable encryption: radio.encrypt("ABCDEFGHIJKLMNOP");
@@ -488,13 +800,13 @@ void RFM69::encrypt(const char* key) {
 #if defined(RF69_LISTENMODE_ENABLE)
     memcpy(_encryptKey, key, 16);
 #endif
+    uint8_t addr = REG_AESKEY1 | 0x80;
     select();
-    _spi->transfer(REG_AESKEY1 | 0x80);
-    for (uint8_t i = 0; i < 16; i++)
-      _spi->transfer(key[i]);
+    spiWrite(&addr, 1);
+    spiWrite(key, 16);
     unselect();
   }
-  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFE) | (validKey ? 1 : 0));
+  writeReg(REG_PACKETCONFIG2, (shadowReg(REG_PACKETCONFIG2) & 0xFE) | (validKey ? 1 : 0));
 }
 
 // get the received signal strength indicator (RSSI)
@@ -525,9 +837,164 @@ void RFM69::writeReg(uint8_t addr, uint8_t value)
   select();
   _spi->transfer(addr | 0x80);
   _spi->transfer(value);
+  shadowWrite(addr, value);
+  unselect();
+}
+
+// the configuration registers the hot path read-modify-writes, and the bits of each that the
+// radio changes by itself (self-clearing or read-only) and the shadow doesn't track
+static const uint8_t RF69_SHADOW[RF69_SHADOW_REGS][2] =
+{
+  { REG_OPMODE, RF_OPMODE_LISTENABORT },
+  { REG_FRFMSB, 0 },
+  { REG_FRFMID, 0 },
+  { REG_FRFLSB, 0 },
+  { REG_LNA, 0x38 }, // LnaCurrentGain
+  { REG_PACKETCONFIG2, RF_PACKET2_RXRESTART },
+};
+
+// internal function - RF69_SHADOW index of addr, RF69_SHADOW_REGS if it isn't shadowed
+static inline uint8_t shadowIndex(uint8_t addr)
+{
+  switch (addr)
+  {
+    case REG_OPMODE: return 0;
+    case REG_FRFMSB: return 1;
+    case REG_FRFMID: return 2;
+    case REG_FRFLSB: return 3;
+    case REG_LNA: return 4;
+    case REG_PACKETCONFIG2: return 5;
+    default: return RF69_SHADOW_REGS;
+  }
+}
+
+// internal function - keep the shadow in step with a register write
+void RFM69::shadowWrite(uint8_t addr, uint8_t value)
+{
+  uint8_t i = shadowIndex(addr);
+  if (i < RF69_SHADOW_REGS) _shadow[i] = value & ~RF69_SHADOW[i][1];
+}
+
+// the last value written to a shadowed register, without an SPI read
+uint8_t RFM69::shadowReg(uint8_t addr)
+{
+  uint8_t i = shadowIndex(addr);
+  if (i >= RF69_SHADOW_REGS) return readReg(addr);
+#if defined(RF69_SHADOW_VERIFY)
+  uint8_t actual = readReg(addr) & ~RF69_SHADOW[i][1];
+  if (actual != _shadow[i])
+  {
+    _shadowMismatches++;
+    _shadow[i] = actual;
+  }
+#endif
+  return _shadow[i];
+}
+
+// internal function - fill the shadow from the radio
+void RFM69::loadShadow()
+{
+  for (uint8_t i = 0; i < RF69_SHADOW_REGS; i++)
+    _shadow[i] = readReg(RF69_SHADOW[i][0]) & ~RF69_SHADOW[i][1];
+}
+
+// compare the shadow with the radio, returns the number of registers that differ
+uint8_t RFM69::verifyShadow()
+{
+  uint8_t mismatches = 0;
+  for (uint8_t i = 0; i < RF69_SHADOW_REGS; i++)
+    mismatches += (readReg(RF69_SHADOW[i][0]) & ~RF69_SHADOW[i][1]) != _shadow[i];
+  return mismatches;
+}
+
+// internal function - restart the receiver, it drops whatever it was receiving. From loop()
+// only: isr0() counts restarts too, so the count is made with interrupts off
+void RFM69::rxRestart()
+{
+  noInterrupts();
+  _stats.rxRestarts++;
+  interrupts();
+  writeReg(REG_PACKETCONFIG2, shadowReg(REG_PACKETCONFIG2) | RF_PACKET2_RXRESTART);
+}
+
+// internal function - rxRestart() for isr0(), where interrupts are off already and must stay off
+void RFM69::rxRestartFromIsr()
+{
+  _stats.rxRestarts++;
+  writeReg(REG_PACKETCONFIG2, shadowReg(REG_PACKETCONFIG2) | RF_PACKET2_RXRESTART);
+}
+
+// internal function - restart the receiver before carrier sense to avoid RX deadlocks, but not
+// while it has matched a sync word: that would throw away a frame on its way in, and carrier
+// sense finds the channel busy until it is over anyway
+void RFM69::rxRestartIdle()
+{
+  if (!(readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_SYNCADDRESSMATCH)) rxRestart();
+}
+
+// the SX1231 increments the address after every byte, so a run of registers costs one
+// select()/unselect() (SPI transaction, SPCR/SPSR save and restore) instead of one each
+void RFM69::readRegs(uint8_t addr, uint8_t* values, uint8_t len)
+{
+  select();
+  _spi->transfer(addr & 0x7F);
+  for (uint8_t i = 0; i < len; i++) values[i] = _spi->transfer(0);
   unselect();
 }
 
+void RFM69::writeRegs(uint8_t addr, const uint8_t* values, uint8_t len)
+{
+  select();
+  _spi->transfer(addr | 0x80);
+  for (uint8_t i = 0; i < len; i++)
+  {
+    _spi->transfer(values[i]);
+    shadowWrite(addr + i, values[i]);
+  }
+  unselect();
+}
+
+// internal function - clock len bytes out to the selected radio and throw away what comes back
+void RFM69::spiWrite(const void* data, uint8_t len)
+{
+  const uint8_t* p = (const uint8_t*)data;
+#if defined(__AVR__)
+  // the 328P has the one hardware SPI: load SPDR with the next byte as soon as SPIF says the
+  // last one is out, instead of a transfer() call and return per byte
+  if (len == 0) return;
+  SPDR = *p++;
+  while (--len)
+  {
+    uint8_t next = *p++;
+    while (!(SPSR & _BV(SPIF)));
+    SPDR = next;
+  }
+  while (!(SPSR & _BV(SPIF)));
+#else
+  while (len--) _spi->transfer(*p++);
+#endif
+}
+
+// internal function - write an { addr, value } table ending in addr 255, each run of
+// consecutive addresses as one burst
+void RFM69::writeRegTable(const uint8_t table[][2])
+{
+  for (uint8_t i = 0; table[i][0] != 255; i++)
+  {
+    select();
+    _spi->transfer(table[i][0] | 0x80);
+    _spi->transfer(table[i][1]);
+    shadowWrite(table[i][0], table[i][1]);
+    while (table[i + 1][0] == table[i][0] + 1)
+    {
+      i++;
+      _spi->transfer(table[i][1]);
+      shadowWrite(table[i][0], table[i][1]);
+    }
+    unselect();
+  }
+}
+
 // select the RFM69 transceiver (save SPI settings, set CS low)
 void RFM69::select() {
 #if defined (SPCR) && defined (SPSR)
@@ -606,11 +1073,15 @@ bool RFM69::setIrq(uint8_t newIRQPin) {
 
   // disconnect from existing IRQ pin
   detachInterrupt( _interruptNum );
+#ifdef SPI_HAS_TRANSACTION
+  _spi->notUsingInterrupt(_interruptNum);
+#endif
 
   _interruptNum = _newInterruptNum;
-  attachInterrupt(_interruptNum, RFM69::isr0, RISING);
-
-  return true;
+#ifdef SPI_HAS_TRANSACTION
+  _spi->usingInterrupt(_interruptNum);
+#endif
+  return attachIsr();
 }
 
 //for debugging
@@ -939,17 +1410,65 @@ void RFM69::rcCalibration()
 // radio300KBPS() - switch radio to max bitrate
 //===================================================================================================================
 void RFM69::set300KBPS() {
-  writeReg(0x03, 0x00);  //REG_BITRATEMSB: 300kbps (0x006B, see DS p20)
-  writeReg(0x04, 0x6B);  //REG_BITRATELSB: 300kbps (0x006B, see DS p20)
-  writeReg(0x19, 0x40);  //REG_RXBW: 500kHz
-  writeReg(0x1A, 0x80);  //REG_AFCBW: 500kHz
-  writeReg(0x05, 0x13);  //REG_FDEVMSB: 300khz (0x1333)
-  writeReg(0x06, 0x33);  //REG_FDEVLSB: 300khz (0x1333)
+  const uint8_t modulation[4] = { 0x00, 0x6B, 0x13, 0x33 }; // 0x03-0x06 REG_BITRATE: 300kbps (0x006B, see DS p20), REG_FDEV: 300khz (0x1333)
+  const uint8_t bandwidth[2] = { 0x40, 0x80 };               // 0x19-0x1A REG_RXBW, REG_AFCBW: 500kHz
+  writeRegs(REG_BITRATEMSB, modulation, sizeof(modulation));
+  writeRegs(REG_RXBW, bandwidth, sizeof(bandwidth));
   writeReg(0x29, 240);   //set REG_RSSITHRESH to -120dBm
   writeReg(0x37, 0b10010000); //DC=WHITENING, CRCAUTOOFF=0
+  _profile = RF69_PROFILE_300KBPS; // the same bitrate, so airtimeUs() stays right
   //                      ** DC: 00 none, 01 manchester, 10, whitening
 }
 
+//===================================================================================================================
+// setProfile() - switch every modulation setting at once, e.g. to change the whole network's bitrate at
+// an agreed time. The receiver restarts on the new settings; a frame being received is lost
+//===================================================================================================================
+static const RFM69Profile RF69_PROFILE_TABLE[RF69_PROFILES] PROGMEM = {
+  // bitrate, fdev, rxBw, afcBw, rssiThresh
+  { (RF_BITRATEMSB_55555 << 8) | RF_BITRATELSB_55555, (RF_FDEVMSB_50000 << 8) | RF_FDEVLSB_50000,
+    RF_RXBW_DCCFREQ_010 | RF_RXBW_MANT_16 | RF_RXBW_EXP_2, 0x8B, 220 },   // 125kHz, AFC at its reset value
+  { 0x006B, 0x1333, 0x40, 0x80, 240 },                                    // as set300KBPS()
+  { (RF_BITRATEMSB_19200 << 8) | RF_BITRATELSB_19200, (RF_FDEVMSB_20000 << 8) | RF_FDEVLSB_20000,
+    RF_RXBW_DCCFREQ_010 | RF_RXBW_MANT_24 | RF_RXBW_EXP_3, RF_RXBW_DCCFREQ_100 | RF_RXBW_MANT_20 | RF_RXBW_EXP_3, 228 }, // 41.7kHz
+};
+
+bool RFM69::setProfile(uint8_t profile) {
+  if (profile >= RF69_PROFILES || _mode == RF69_MODE_TX) return false;
+  const RFM69Profile* p = &RF69_PROFILE_TABLE[profile];
+  uint16_t bitrate = pgm_read_word(&p->bitrate);
+  uint16_t fdev = pgm_read_word(&p->fdev);
+  uint8_t modulation[4] = { (uint8_t)(bitrate >> 8), (uint8_t)bitrate, (uint8_t)(fdev >> 8), (uint8_t)fdev }; // 0x03-0x06
+  uint8_t bandwidth[2] = { pgm_read_byte(&p->rxBw), pgm_read_byte(&p->afcBw) };                             // 0x19-0x1A
+  uint8_t mode = _mode;
+  setMode(RF69_MODE_STANDBY);
+  writeRegs(REG_BITRATEMSB, modulation, sizeof(modulation));
+  writeRegs(REG_RXBW, bandwidth, sizeof(bandwidth));
+  writeReg(REG_RSSITHRESH, pgm_read_byte(&p->rssiThresh));
+  _profile = profile;
+  if (mode == RF69_MODE_RX) receiveBegin();
+  return true;
+}
+
+uint32_t RFM69::profileBitrate(uint8_t profile) {
+  if (profile >= RF69_PROFILES) return 0;
+  return 32000000UL / pgm_read_word(&RF69_PROFILE_TABLE[profile].bitrate);
+}
+
+// on-air time in us of a frame with payloadLen bytes after the header. The bitrate register
+// holds 32MHz / bps, so a byte takes 8 * register / 32 us and there is no division in isr0()
+uint32_t RFM69::airtimeUs(uint8_t profile, uint8_t payloadLen, bool encrypted) {
+  if (profile >= RF69_PROFILES) return 0;
+  uint16_t message = RF69_HEADER_BYTES + payloadLen;
+  if (encrypted) message = (message + RF69_AES_BLOCK - 1) / RF69_AES_BLOCK * RF69_AES_BLOCK;
+  uint16_t bytes = RF69_PREAMBLE_BYTES + RF69_SYNC_BYTES + 1 + message + RF69_CRC_BYTES;
+  return ((uint32_t)bytes * pgm_read_word(&RF69_PROFILE_TABLE[profile].bitrate) + 3) / 4;
+}
+
+uint32_t RFM69::airtimeUs(uint8_t payloadLen) {
+  return airtimeUs(_profile, payloadLen, shadowReg(REG_PACKETCONFIG2) & RF_PACKET2_AES_ON);
+}
+
 //=============================================================================
 // setLNA() - disable the AGC and set a manual gain to attenuate input signal
 // Makes receiver hear a "weaker" signal.
@@ -966,7 +1485,7 @@ void RFM69::set300KBPS() {
 //=============================================================================
 uint8_t RFM69::setLNA(uint8_t newReg) {
   byte oldReg;
-  oldReg = readReg(REG_LNA);
+  oldReg = shadowReg(REG_LNA);
   writeReg(REG_LNA, ((newReg & 7) | (oldReg & ~7))); // just control the LNA Gain bits for now
   return oldReg;  // return the original value in case we need to restore it
 }
@@ -980,10 +1499,8 @@ void RFM69::listenModeSleep(uint16_t millisInterval)
   detachInterrupt( _interruptNum );
   //attachInterrupt( _interruptNum, delayIrq, RISING);
   writeReg( REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_11 );
-  writeReg( REG_BITRATEMSB, RF_BITRATEMSB_200000);
-  writeReg( REG_BITRATELSB, RF_BITRATELSB_200000);
-  writeReg( REG_FDEVMSB, RF_FDEVMSB_100000 );
-  writeReg( REG_FDEVLSB, RF_FDEVLSB_100000 );
+  const uint8_t modulation[4] = { RF_BITRATEMSB_200000, RF_BITRATELSB_200000, RF_FDEVMSB_100000, RF_FDEVLSB_100000 };
+  writeRegs( REG_BITRATEMSB, modulation, sizeof(modulation) );
   writeReg( REG_RXBW, RF_RXBW_DCCFREQ_000 | RF_RXBW_MANT_16 | RF_RXBW_EXP_0 );
 
   uint8_t idleResol;
@@ -1003,9 +1520,9 @@ void RFM69::listenModeSleep(uint16_t millisInterval)
     divisor = 64;
   }
 
-  writeReg( REG_LISTEN1, RF_LISTEN1_RESOL_RX_64 | idleResol | RF_LISTEN1_CRITERIA_RSSI | RF_LISTEN1_END_10 );
-  writeReg( REG_LISTEN2, (microInterval + (divisor >> 1 ) ) / divisor );
-  writeReg( REG_LISTEN3, 4 );
+  uint8_t listen[3] = { (uint8_t)(RF_LISTEN1_RESOL_RX_64 | idleResol | RF_LISTEN1_CRITERIA_RSSI | RF_LISTEN1_END_10 ),
+                        (uint8_t)((microInterval + (divisor >> 1 ) ) / divisor), 4 };
+  writeRegs( REG_LISTEN1, listen, sizeof(listen) );
   writeReg( REG_RSSITHRESH, 255 );
   writeReg( REG_RXTIMEOUT2, 1 );
   writeReg( REG_OPMODE, RF_OPMODE_SEQUENCER_ON | RF_OPMODE_STANDBY  );
@@ -1048,7 +1565,7 @@ bool RFM69::reinitRadio()
 {
   if (!initialize(_freqBand, _address, _networkID)) return false;
   if (_haveEncryptKey) RFM69::encrypt(_encryptKey); // Restore the encryption key if necessary
-  if (_isHighSpeed) writeReg(REG_LNA, (readReg(REG_LNA) & ~0x3) | RF_LNA_GAINSELECT_AUTO);
+  if (_isHighSpeed) writeReg(REG_LNA, (shadowReg(REG_LNA) & ~0x3) | RF_LNA_GAINSELECT_AUTO);
   return true;
 }
 
@@ -1156,10 +1673,11 @@ void RFM69::listenModeInterruptHandler(void)
 
   burstRemaining.l = 0;
 
-  _spi->transfer(REG_FIFO & 0x7F);
-  PAYLOADLEN = _spi->transfer(0);
-  PAYLOADLEN = PAYLOADLEN > 64 ? 64 : PAYLOADLEN; // precaution
-  TARGETID = _spi->transfer(0);
+  uint8_t header[3]; // FIFO address byte, len, target
+  header[0] = REG_FIFO & 0x7F;
+  _spi->transfer(header, sizeof(header));
+  PAYLOADLEN = header[1] > 64 ? 64 : header[1]; // precaution
+  TARGETID = header[2];
   if(!(_spyMode || TARGETID == _address || TARGETID == RF69_BROADCAST_ADDR) // match this node's address, or broadcast address or anything in spy mode
      || PAYLOADLEN < 3) // address situation could receive packets that are malformed and don't fit this library's extra fields
   {
@@ -1169,13 +1687,13 @@ void RFM69::listenModeInterruptHandler(void)
 
   // We've read the target, and will read the sender id and two time offset bytes for a total of 4 bytes
   DATALEN = PAYLOADLEN - 4;
-  SENDERID = _spi->transfer(0);
-  burstRemaining.b[0] =  _spi->transfer(0);  // and get the time remaining
-  burstRemaining.b[1] =  _spi->transfer(0);
+  _spi->transfer(header, sizeof(header));   // sender and the time remaining
+  SENDERID = header[0];
+  burstRemaining.b[0] = header[1];
+  burstRemaining.b[1] = header[2];
   RF69_LISTEN_BURST_REMAINING_MS = burstRemaining.l;
 
-  for (uint8_t i = 0; i < DATALEN; i++)
-    DATA[i] = _spi->transfer(0);
+  _spi->transfer(DATA, DATALEN);
 
   if (DATALEN < RF69_MAX_DATA_LEN)
     DATA[DATALEN] = 0; // add null at end of string
@@ -1198,18 +1716,17 @@ void RFM69::listenModeStart(void)
   attachInterrupt(_interruptNum, listenModeIrq, RISING);
   setMode(RF69_MODE_STANDBY);
   writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_01);
-  writeReg(REG_FRFMSB, readReg(REG_FRFMSB) + 1);
-  writeReg(REG_FRFLSB, readReg(REG_FRFLSB));      // MUST write to LSB to affect change!
+  listenModeShiftFrequency();
 
   listenModeApplyHighSpeedSettings();
 
   writeReg(REG_PACKETCONFIG1, RF_PACKET1_FORMAT_VARIABLE | RF_PACKET1_DCFREE_WHITENING | RF_PACKET1_CRC_ON | RF_PACKET1_CRCAUTOCLEAR_ON);
   writeReg(REG_PACKETCONFIG2, RF_PACKET2_RXRESTARTDELAY_NONE | RF_PACKET2_AUTORXRESTART_ON | RF_PACKET2_AES_OFF);
-  writeReg(REG_SYNCVALUE1, 0x5A);
-  writeReg(REG_SYNCVALUE2, 0x5A);
-  writeReg(REG_LISTEN1, _rxListenResolution | _idleListenResolution | RF_LISTEN1_CRITERIA_RSSI | RF_LISTEN1_END_10);
-  writeReg(REG_LISTEN2, _idleListenCoef);
-  writeReg(REG_LISTEN3, _rxListenCoef);
+  const uint8_t sync[2] = { 0x5A, 0x5A };
+  writeRegs(REG_SYNCVALUE1, sync, sizeof(sync));
+  uint8_t listen[3] = { (uint8_t)(_rxListenResolution | _idleListenResolution | RF_LISTEN1_CRITERIA_RSSI | RF_LISTEN1_END_10),
+                        _idleListenCoef, _rxListenCoef };
+  writeRegs(REG_LISTEN1, listen, sizeof(listen));
   writeReg(REG_RSSITHRESH, 180);
   writeReg(REG_RXTIMEOUT2, 75);
   writeReg(REG_OPMODE, RF_OPMODE_SEQUENCER_ON | RF_OPMODE_STANDBY);
@@ -1231,13 +1748,20 @@ void RFM69::listenModeEnd(void)
   reinitRadio();
 }
 
+// move FRF up by one MSB step: listen mode bursts stay off the normal channel
+void RFM69::listenModeShiftFrequency()
+{
+  uint8_t frf[3];
+  readRegs(REG_FRFMSB, frf, sizeof(frf));
+  frf[0]++;
+  writeRegs(REG_FRFMSB, frf, sizeof(frf)); // MUST write to LSB to affect change, it goes last
+}
+
 void RFM69::listenModeApplyHighSpeedSettings()
 {
   if (!_isHighSpeed) return;
-  writeReg(REG_BITRATEMSB, RF_BITRATEMSB_200000);
-  writeReg(REG_BITRATELSB, RF_BITRATELSB_200000);
-  writeReg(REG_FDEVMSB, RF_FDEVMSB_100000);
-  writeReg(REG_FDEVLSB, RF_FDEVLSB_100000);
+  const uint8_t modulation[4] = { RF_BITRATEMSB_200000, RF_BITRATELSB_200000, RF_FDEVMSB_100000, RF_FDEVLSB_100000 };
+  writeRegs(REG_BITRATEMSB, modulation, sizeof(modulation));
   writeReg( REG_RXBW, RF_RXBW_DCCFREQ_000 | RF_RXBW_MANT_20 | RF_RXBW_EXP_0 );
   
   // Force LNA to the highest gain
@@ -1253,11 +1777,10 @@ void RFM69::listenModeSendBurst( uint8_t targetNode, const void* buffer, uint8_t
   setMode(RF69_MODE_STANDBY);
   writeReg(REG_PACKETCONFIG1, RF_PACKET1_FORMAT_VARIABLE | RF_PACKET1_DCFREE_WHITENING | RF_PACKET1_CRC_ON | RF_PACKET1_CRCAUTOCLEAR_ON );
   writeReg(REG_PACKETCONFIG2, RF_PACKET2_RXRESTARTDELAY_NONE | RF_PACKET2_AUTORXRESTART_ON | RF_PACKET2_AES_OFF);
-  writeReg(REG_SYNCVALUE1, 0x5A);
-  writeReg(REG_SYNCVALUE2, 0x5A);
+  const uint8_t sync[2] = { 0x5A, 0x5A };
+  writeRegs(REG_SYNCVALUE1, sync, sizeof(sync));
   listenModeApplyHighSpeedSettings();
-  writeReg(REG_FRFMSB, readReg(REG_FRFMSB) + 1);
-  writeReg(REG_FRFLSB, readReg(REG_FRFLSB));      // MUST write to LSB to affect change!
+  listenModeShiftFrequency();
 
   union // union to simplify addressing of long and short parts of time offset
   {
@@ -1281,20 +1804,13 @@ void RFM69::listenModeSendBurst( uint8_t targetNode, const void* buffer, uint8_t
   while(timeRemaining.l > 0) {
     noInterrupts();
     // write to FIFO
+    // two bytes for target and sender node, then the burst time remaining so the receiver
+    // knows how long to wait before trying to reply
+    uint8_t header[6] = { REG_FIFO | 0x80, (uint8_t)(size + 4), (uint8_t)targetNode, (uint8_t)_address,
+                          timeRemaining.b[0], timeRemaining.b[1] };
     select();
-    _spi->transfer(REG_FIFO | 0x80);
-    _spi->transfer(size + 4);      // two bytes for target and sender node, two bytes for the burst time remaining
-    _spi->transfer(targetNode);
-    _spi->transfer(_address);
-
-    // We send the burst time remaining with the packet so the receiver knows how long to wait before trying to reply
-    _spi->transfer(timeRemaining.b[0]);
-    _spi->transfer(timeRemaining.b[1]);
-
-    for (uint8_t i = 0; i < size; i++) {
-      _spi->transfer(((uint8_t*) buffer)[i]);
-    }
-
+    spiWrite(header, sizeof(header));
+    spiWrite(buffer, size);
     unselect();
     interrupts();
 
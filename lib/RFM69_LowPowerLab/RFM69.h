@@ -163,8 +163,54 @@
 #define RF69_BROADCAST_ADDR   0
 #define RF69_CSMA_LIMIT_MS 1000
 #define RF69_TX_LIMIT_MS   1000
+// sendAsync() and receive queues; override with build flags
+#ifndef RF69_TX_QUEUE_LEN
+  #define RF69_TX_QUEUE_LEN      4  // frames waiting for the channel
+#endif
+#ifndef RF69_TX_QUEUE_DATA_LEN
+  #define RF69_TX_QUEUE_DATA_LEN 24 // largest payload sendAsync() accepts, keeps the queue small on 2K RAM parts
+#endif
+#ifndef RF69_RX_QUEUE_LEN
+  #define RF69_RX_QUEUE_LEN      4  // received frames isr0() can hold, including the one being read; power of 2
+#endif
+// carrier sense backoff, see setCsmaBackoff(); override the defaults with build flags
+#ifndef RF69_CSMA_SLOT_US
+  #define RF69_CSMA_SLOT_US      500 // covers the TX ramp plus the RSSI settling at the other nodes
+#endif
+#ifndef RF69_CSMA_MIN_BE
+  #define RF69_CSMA_MIN_BE       3  // a new frame waits 0 to 2^3-1 slots before its first listen
+#endif
+#ifndef RF69_CSMA_MAX_BE
+  #define RF69_CSMA_MAX_BE       6  // each busy listen doubles the window, up to 2^6 slots (32ms)
+#endif
+#define RF69_CSMA_ACK_BE         0  // sendACK() listens right away, the sender is waiting for it
+#define RF69_CSMA_BE_LIMIT       15
+#define RF69_TX_IDLE       0 // queue empty or waiting for RX mode
+#define RF69_TX_CSMA       1 // head frame waiting for a clear channel
+#define RF69_TX_SENDING    2 // head frame on the air, isr0() flags PacketSent
 #define RF69_FSTEP  61.03515625 // == FXOSC / 2^19 = 32MHz / 2^19 (p13 in datasheet)
 
+// modulation profiles for setProfile(), every node on a network must use the same one
+#define RF69_PROFILE_55KBPS    0 // what initialize() sets up
+#define RF69_PROFILE_300KBPS   1 // set300KBPS(): fastest, shortest range
+#define RF69_PROFILE_19KBPS    2 // 19.2kbps with a narrow filter, for range
+#define RF69_PROFILES          3
+
+#define RF69_SHADOW_REGS       6 // registers kept in RAM, see shadowReg()
+#define RF69_MAX_RADIOS        2 // instances that can be initialized at once, one per isr0()/isr1()
+#define RF69_STATS_BUCKETS     8 // log2 ms histogram buckets: under 1ms, 1ms, 2-3ms, 4-7ms ... 64ms and over
+#define RF69_STATS_RETRIES     4 // sendWithRetry() successes after 0, 1, 2, 3+ retries
+
+// on-air frame layout for airtimeUs(): preamble, sync word, length byte, the header
+// (target, sender, CTL), payload and CRC. With AES the header and payload go out in
+// whole 16 byte blocks.
+#define RF69_PREAMBLE_BYTES    3 // REG_PREAMBLEMSB/LSB, left at the reset value
+#define RF69_SYNC_BYTES        2 // REG_SYNCCONFIG: 0x2D and the network ID
+#define RF69_HEADER_BYTES      3
+#define RF69_CRC_BYTES         2
+#define RF69_AES_BLOCK        16
+#define RF69_AIRTIME_PERIOD_MS 1000 // lastAirtime() covers the last whole period
+
 // TWS: define CTLbyte bits
 #define RFM69_CTL_SENDACK   0x80
 #define RFM69_CTL_REQACK    0x40
@@ -183,17 +229,66 @@
   #define  DEFAULT_LISTEN_IDLE_US 1000000
 #endif
 
+// register values of one modulation profile
+struct RFM69Profile {
+  uint16_t bitrate;   // REG_BITRATEMSB/LSB, 32MHz / bps
+  uint16_t fdev;      // REG_FDEVMSB/LSB, Hz / RF69_FSTEP
+  uint8_t rxBw;       // REG_RXBW
+  uint8_t afcBw;      // REG_AFCBW
+  uint8_t rssiThresh; // REG_RSSITHRESH, -2 * dBm
+};
+
+// one received frame, queued by isr0() and handed out by receiveNext()
+struct RFM69Frame {
+  uint16_t senderId;
+  uint16_t targetId;
+  uint8_t ctl;       // CTL byte, RFM69_CTL_* flags
+  uint8_t len;       // payload bytes in data
+  int16_t rssi;      // dBm, measured while the frame was received
+  uint32_t micros;   // micros() when PayloadReady fired
+  uint8_t data[RF69_MAX_DATA_LEN];
+};
+
+// randomized binary exponential backoff of one frame waiting for the channel
+struct RFM69Backoff {
+  uint8_t exponent;   // the window is 2^exponent slots
+  uint16_t slots;     // left before the next listen
+  uint32_t slotStart; // micros() the current slot began
+};
+
+// always-on counters, see readStats(). 16 bit counts wrap, histograms are in statsBucket()s.
+// An increment isn't atomic on AVR, so each counter is only changed from isr0() or only
+// from loop(); rxRestarts, counted in both, is changed with interrupts off in loop()
+struct RFM69Stats {
+  uint32_t framesSent;      // PacketSent, ACKs included
+  uint32_t framesReceived;  // queued for the sketch
+  uint16_t addressFiltered; // for another node
+  uint16_t badFrames;       // too short or too long for this driver's header; CRC failures never leave the radio
+  uint16_t rxDropped;       // receive queue full
+  uint16_t rxRestarts;
+  uint16_t csmaTimeouts;    // sent anyway after RF69_CSMA_LIMIT_MS of a busy channel
+  uint16_t txTimeouts;      // no PacketSent within RF69_TX_LIMIT_MS
+  uint16_t retryFailures;   // sendWithRetry() calls that never got an ACK
+  uint16_t csmaBusy;        // listens at the end of a backoff that found the channel busy
+  uint16_t csmaWait[RF69_STATS_BUCKETS]; // wait for a clear channel before each frame
+  uint16_t ackRtt[RF69_STATS_BUCKETS];   // end of transmit to ACK, in sendWithRetry()
+  uint16_t retries[RF69_STATS_RETRIES];  // sendWithRetry() calls that got an ACK, by retries needed
+  uint32_t txAirtimeUs;     // on-air time of every frame sent, wraps after ~71 minutes
+  uint32_t rxAirtimeUs;     // of every frame received, filtered and dropped ones included
+};
+
 class RFM69 {
   public:
-    static uint8_t DATA[RF69_MAX_DATA_LEN+1]; // RX/TX payload buffer, including end of string NULL char
-    static uint8_t DATALEN;
-    static uint16_t SENDERID;
-    static uint16_t TARGETID; // should match _address
-    static uint8_t PAYLOADLEN;
-    static uint8_t ACK_REQUESTED;
-    static uint8_t ACK_RECEIVED; // should be polled immediately after sending a packet with ACK request
-    static int16_t RSSI; // most accurate RSSI during reception (closest to the reception). RSSI of last packet.
-    static uint8_t _mode; // should be protected?
+    // per instance, so two radios can run side by side (see RF69_MAX_RADIOS)
+    uint8_t DATA[RF69_MAX_DATA_LEN+1]; // RX/TX payload buffer, including end of string NULL char
+    uint8_t DATALEN;
+    uint16_t SENDERID;
+    uint16_t TARGETID; // should match _address
+    uint8_t PAYLOADLEN;
+    uint8_t ACK_REQUESTED;
+    uint8_t ACK_RECEIVED; // should be polled immediately after sending a packet with ACK request
+    int16_t RSSI; // most accurate RSSI during reception (closest to the reception). RSSI of last packet.
+    volatile uint8_t _mode; // should be protected? written by isr0() as well as loop()
 
     RFM69(uint8_t slaveSelectPin, uint8_t interruptPin, bool isRFM69HW, uint8_t interruptNum __attribute__((unused))) //interruptNum is now deprecated
                 : RFM69(slaveSelectPin, interruptPin, isRFM69HW){};
@@ -204,9 +299,25 @@ class RFM69 {
     void setAddress(uint16_t addr);
     void setNetwork(uint8_t networkID);
     virtual bool canSend();
+    // slotted backoff for send(), sendACK() and the sendAsync() queue: a frame waits a random
+    // 0 to 2^minBE-1 slots, then listens once; while the channel is busy the window doubles up
+    // to 2^maxBE slots and it waits again. minBE 0 listens right away, like canSend() polling did
+    bool setCsmaBackoff(uint8_t minBE, uint8_t maxBE, uint16_t slotUs=RF69_CSMA_SLOT_US);
     virtual void send(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false);
+    bool sendAsync(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK=false, bool stamp=false); // false if the queue is full
+    uint8_t txQueued() { return _txCount; } // frames not yet fully sent
+    bool txStamp(uint32_t& txMicros);       // once per sent stamp frame: micros() when PacketSent fired for it
+    void txHold(bool hold) { _txHold = hold; } // queued frames wait while held, one on the air finishes
     virtual bool sendWithRetry(uint16_t toAddress, const void* buffer, uint8_t bufferSize, uint8_t retries=2, uint8_t retryWaitTime=RFM69_ACK_TIMEOUT);
     virtual bool receiveDone();
+    const RFM69Frame* receiveNext(); // oldest received frame or NULL, valid until the next receiveNext()/receiveDone()
+    uint8_t rxQueued();              // frames waiting for receiveNext()
+    uint16_t rxDropped();            // frames lost because the receive queue was full
+    void readStats(RFM69Stats& stats, bool reset=false); // a consistent copy, then zeroed with reset
+    static uint8_t statsBucket(uint32_t ms);
+    uint32_t airtimeUs(uint8_t payloadLen); // on-air time of a frame with the current profile and encryption
+    static uint32_t airtimeUs(uint8_t profile, uint8_t payloadLen, bool encrypted=false);
+    void lastAirtime(uint32_t& txUs, uint32_t& rxUs); // airtime in the last whole RF69_AIRTIME_PERIOD_MS
     bool ACKReceived(uint16_t fromNodeID);
     bool ACKRequested();
     virtual void sendACK(const void* buffer = "", uint8_t bufferSize=0);
@@ -227,13 +338,27 @@ class RFM69 {
     uint8_t readTemperature(uint8_t calFactor=0); // get CMOS temperature (8bit)
     void rcCalibration(); // calibrate the internal RC oscillator for use in wide temperature variations - see datasheet section [4.3.5. RC Timer Accuracy]
     void set300KBPS();
+    bool setProfile(uint8_t profile); // false for an unknown profile or while a frame is on the air
+    uint8_t profile() { return _profile; }
+    static uint32_t profileBitrate(uint8_t profile); // bps, 0 for an unknown profile
     uint8_t setLNA(uint8_t newReg);
 
     // allow hacking registers by making these public
     uint8_t readReg(uint8_t addr);
     void writeReg(uint8_t addr, uint8_t val);
+    // burst access to len consecutive registers in one SPI transaction (address auto-increment)
+    void readRegs(uint8_t addr, uint8_t* values, uint8_t len);
+    void writeRegs(uint8_t addr, const uint8_t* values, uint8_t len);
     void readAllRegs();
     void readAllRegsCompact();
+    // RAM shadow of the configuration registers the driver read-modify-writes (OPMODE, FRF,
+    // LNA, PACKETCONFIG2). Build with RF69_SHADOW_VERIFY to check every shadow read against
+    // the radio and count the mismatches.
+    uint8_t shadowReg(uint8_t addr);
+    uint8_t verifyShadow();
+#if defined(RF69_SHADOW_VERIFY)
+    uint16_t shadowMismatches() { return _shadowMismatches; }
+#endif
 
     // ListenMode sleep/timer
     void listenModeSleep(uint16_t millisInterval);
@@ -244,10 +369,69 @@ class RFM69 {
 
   protected:
     static void isr0();
+    static void isr1();
+    bool attachIsr();
+    void isr();
     void interruptHandler();
-    virtual void interruptHook(uint8_t CTLbyte __attribute__((unused))) {};
-    static volatile bool _haveData;
+    void packetSentHandler();
+    virtual void interruptHook(RFM69Frame& frame __attribute__((unused))) {};
+    volatile bool _haveData;
+    volatile bool _packetSent; // set by isr() when DIO0 (mapped to PacketSent) rises in TX
+    volatile uint32_t _packetSentMicros; // micros() at that moment
+    static RFM69* _isrRadios[RF69_MAX_RADIOS]; // the instance each of isr0()/isr1() serves
     virtual void sendFrame(uint16_t toAddress, const void* buffer, uint8_t size, bool requestACK=false, bool sendACK=false);
+    virtual void startFrame(uint16_t toAddress, const void* buffer, uint8_t size, bool requestACK=false, bool sendACK=false);
+    bool txPoll();
+    void listen();
+    void writeRegTable(const uint8_t table[][2]);
+    void spiWrite(const void* data, uint8_t len);
+    void shadowWrite(uint8_t addr, uint8_t value);
+    void loadShadow();
+    void rxRestart();
+    void rxRestartFromIsr();
+    void rxRestartIdle();
+    void waitForChannel(uint8_t minBE);
+    void backoffStart(RFM69Backoff& backoff, uint8_t exponent);
+    bool backoffClear(RFM69Backoff& backoff);
+    uint16_t backoffRandom();
+    void countCsma(uint32_t startMs, bool clear);
+    void countAck(uint8_t retries, uint32_t sentMs);
+    void countAirtime(uint8_t payloadLen, bool tx);
+    void rollAirtime(uint32_t now);
+
+    struct TxFrame {
+      uint16_t toAddress;
+      uint8_t size;
+      bool requestACK;
+      bool stamp;     // keep the PacketSent time for txStamp()
+      uint8_t data[RF69_TX_QUEUE_DATA_LEN];
+    };
+    TxFrame _txQueue[RF69_TX_QUEUE_LEN];
+    uint8_t _txHead;
+    uint8_t _txCount;
+    uint8_t _txState;
+    uint32_t _txStart; // millis() when the head frame entered its current state
+    uint8_t _txLen;    // payload bytes of the frame on the air, for countAirtime()
+    RFM69Backoff _txBackoff; // of the head frame, while RF69_TX_CSMA
+    uint8_t _csmaMinBE;
+    uint8_t _csmaMaxBE;
+    uint16_t _csmaSlotUs;
+    uint16_t _backoffSeed; // xorshift state, seeded per node so hats don't pick the same slots
+    uint32_t _txStampMicros;
+    bool _txStamped;
+    bool _txHold;
+
+    RFM69Frame _rxQueue[RF69_RX_QUEUE_LEN];
+    volatile uint8_t _rxHead; // free running, next frame for receiveNext()
+    volatile uint8_t _rxTail; // free running, next slot isr0() fills
+    bool _rxHeld;             // _rxQueue[_rxHead] was handed out and is still in use
+
+    RFM69Stats _stats; // partly updated by isr0(), read it with readStats()
+    uint32_t _airPeriodStart; // millis() the current airtime period began
+    uint32_t _airTxUs;        // airtime so far in that period
+    uint32_t _airRxUs;
+    uint32_t _airLastTxUs;    // in the last whole period
+    uint32_t _airLastRxUs;
 
     // for ListenMode sleep/timer
     static void delayIrq();
@@ -258,6 +442,11 @@ class RFM69 {
     uint16_t _address;
     bool _spyMode;
     uint8_t _powerLevel;
+    uint8_t _profile;
+    uint8_t _shadow[RF69_SHADOW_REGS];
+#if defined(RF69_SHADOW_VERIFY)
+    uint16_t _shadowMismatches;
+#endif
     bool _isRFM69HW;
     SPIClass *_spi;
 #if defined (SPCR) && defined (SPSR)
@@ -305,6 +494,7 @@ class RFM69 {
   protected:
     void listenModeInterruptHandler(void);
     void listenModeApplyHighSpeedSettings();
+    void listenModeShiftFrequency();
     void listenModeReset(); //resets variables used on the receiving end
     bool reinitRadio(void);
     static void listenModeIrq();
@@ -31,8 +31,6 @@
 #include "RFM69registers.h"
 #include <SPI.h>
 
-volatile uint8_t RFM69_ATC::ACK_RSSI_REQUESTED;  // new type of flag on ACK_REQUEST
-
 //=============================================================================
 // initialize() - some extra initialization before calling base class
 //=============================================================================
@@ -53,10 +51,8 @@ void RFM69_ATC::sendACK(const void* buffer, uint8_t bufferSize) {
   uint16_t sender = SENDERID;
   int16_t _RSSI = RSSI; // save payload received RSSI value
   bool sendRSSI = ACK_RSSI_REQUESTED;  
-  writeReg(REG_PACKETCONFIG2, (readReg(REG_PACKETCONFIG2) & 0xFB) | RF_PACKET2_RXRESTART); // avoid RX deadlocks
-  uint32_t now = millis();
-  while (!canSend() && millis() - now < RF69_CSMA_LIMIT_MS) receiveDone();
-  SENDERID = sender;    // TomWS1: Restore SenderID after it gets wiped out by receiveDone()
+  waitForChannel(RF69_CSMA_ACK_BE);
+  SENDERID = sender;    // TomWS1: Restore SenderID after it gets wiped out by receiveBegin()
   sendFrame(sender, buffer, bufferSize, false, true, sendRSSI, _RSSI);   // TomWS1: Special override on sendFrame with extra params
   RSSI = _RSSI; // restore payload RSSI
 }
@@ -73,59 +69,75 @@ void RFM69_ATC::sendFrame(uint16_t toAddress, const void* buffer, uint8_t buffer
 // sendFrame() - the new one with additional parameters.  This packages recv'd RSSI with the packet, if required.
 //=============================================================================
 void RFM69_ATC::sendFrame(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK, bool sendRSSI, int16_t lastRSSI) {
+  startFrame(toAddress, buffer, bufferSize, requestACK, sendACK, sendRSSI, lastRSSI);
+  uint32_t txStart = millis();
+  while (!_packetSent && millis() - txStart < RF69_TX_LIMIT_MS); // isr0() puts the radio in standby when DIO0 signals PacketSent
+  if (!_packetSent) _stats.txTimeouts++;
+  setMode(RF69_MODE_STANDBY);
+}
+
+//=============================================================================
+// startFrame() - matches the RFM69 prototype, used by the sendAsync() queue
+//=============================================================================
+void RFM69_ATC::startFrame(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK) {
+  startFrame(toAddress, buffer, bufferSize, requestACK, sendACK, false, 0);
+}
+
+//=============================================================================
+// startFrame() - fills the FIFO (with ACK RSSI if required) and starts transmitting, does not wait for PacketSent
+//=============================================================================
+void RFM69_ATC::startFrame(uint16_t toAddress, const void* buffer, uint8_t bufferSize, bool requestACK, bool sendACK, bool sendRSSI, int16_t lastRSSI) {
   setMode(RF69_MODE_STANDBY); // turn off receiver to prevent reception while filling fifo
   while ((readReg(REG_IRQFLAGS1) & RF_IRQFLAGS1_MODEREADY) == 0x00); // wait for ModeReady
-  //writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00); // DIO0 is "Packet Sent"
+  writeReg(REG_DIOMAPPING1, RF_DIOMAPPING1_DIO0_00); // DIO0 is "Packet Sent"
 
   bufferSize += (sendACK && sendRSSI)?1:0;  // if sending ACK_RSSI then increase data size by 1
   if (bufferSize > RF69_MAX_DATA_LEN) bufferSize = RF69_MAX_DATA_LEN;
 
-  // write to FIFO
-  select();
-  _spi->transfer(REG_FIFO | 0x80);
-  _spi->transfer(bufferSize + 3);
-  _spi->transfer((uint8_t)toAddress); //lower 8bits
-  _spi->transfer((uint8_t)_address);  //lower 8bits
+  // FIFO address, length, lower 8 bits of both addresses, CTL and the optional ACK RSSI byte
+  uint8_t header[6] = { REG_FIFO | 0x80, (uint8_t)(bufferSize + 3), (uint8_t)toAddress, (uint8_t)_address };
+  uint8_t headerLen = 5;
 
   // CTL (control byte)
   uint8_t CTLbyte=0x0;
   if (toAddress > 0xFF) CTLbyte |= (toAddress & 0x300) >> 6; //assign last 2 bits of address if > 255
   if (_address > 0xFF) CTLbyte |= (_address & 0x300) >> 8;   //assign last 2 bits of address if > 255
   if (sendACK) {                   // TomWS1: adding logic to return ACK_RSSI if requested
-    _spi->transfer(CTLbyte | RFM69_CTL_SENDACK | (sendRSSI?RFM69_CTL_RESERVE1:0));  // TomWS1  TODO: Replace with EXT1
+    header[4] = CTLbyte | RFM69_CTL_SENDACK | (sendRSSI?RFM69_CTL_RESERVE1:0);  // TomWS1  TODO: Replace with EXT1
     if (sendRSSI) {
-      _spi->transfer(abs(lastRSSI)); //RSSI dBm is negative expected between [-100 .. -20], convert to positive and pass along as single extra header byte
+      header[headerLen++] = abs(lastRSSI); //RSSI dBm is negative expected between [-100 .. -20], convert to positive and pass along as single extra header byte
       bufferSize -=1;              // account for the extra ACK-RSSI 'data' byte
     }
   }
   else if (requestACK) {  // TODO: add logic to request ackRSSI with ACK - this is when both ends of a transmission would dial power down. May not work well for gateways in multi node networks
-    _spi->transfer(CTLbyte | (_targetRSSI ? RFM69_CTL_REQACK | RFM69_CTL_RESERVE1 : RFM69_CTL_REQACK));
+    header[4] = CTLbyte | (_targetRSSI ? RFM69_CTL_REQACK | RFM69_CTL_RESERVE1 : RFM69_CTL_REQACK);
   }
-  else _spi->transfer(CTLbyte);
+  else header[4] = CTLbyte;
+  _txLen = header[1] - RF69_HEADER_BYTES; // on the air, ACK RSSI byte included
 
-  for (uint8_t i = 0; i < bufferSize; i++)
-    _spi->transfer(((uint8_t*) buffer)[i]);
+  // write to FIFO
+  select();
+  spiWrite(header, headerLen);
+  spiWrite(buffer, bufferSize);
   unselect();
 
   // no need to wait for transmit mode to be ready since its handled by the radio
+  _packetSent = false;
   setMode(RF69_MODE_TX);
-  //uint32_t txStart = millis();
-  //while (digitalRead(_interruptPin) == 0 && millis() - txStart < RF69_TX_LIMIT_MS); // wait for DIO0 to turn HIGH signalling transmission finish
-  while ((readReg(REG_IRQFLAGS2) & RF_IRQFLAGS2_PACKETSENT) == 0x00); // wait for PacketSent
-  setMode(RF69_MODE_STANDBY);
 }
 
 //=============================================================================
-// interruptHook() - gets called by the base class interrupt handler right after the header is fetched.
+// interruptHook() - gets called by the base class when a received frame is handed to the sketch, before DATA is filled.
 //=============================================================================
-void RFM69_ATC::interruptHook(uint8_t CTLbyte) {
-  ACK_RSSI_REQUESTED = CTLbyte & RFM69_CTL_RESERVE1; // TomWS1: extract the ACK RSSI request bit (could potentially merge with ACK_REQUESTED)
+void RFM69_ATC::interruptHook(RFM69Frame& frame) {
+  ACK_RSSI_REQUESTED = frame.ctl & RFM69_CTL_RESERVE1; // TomWS1: extract the ACK RSSI request bit (could potentially merge with ACK_REQUESTED)
   // TomWS1: now see if this was an ACK with an ACK_RSSI response
-  if (ACK_RECEIVED && ACK_RSSI_REQUESTED) {
-    // the next two bytes contain the ACK_RSSI (assuming the datalength is valid)
-    if (DATALEN >= 1) {
-      _ackRSSI = -1 * _spi->transfer(0); //rssi was sent as single byte positive value, get the real value by * -1
-      DATALEN -= 1;   // and compensate data length accordingly
+  if ((frame.ctl & RFM69_CTL_SENDACK) && ACK_RSSI_REQUESTED) {
+    // the first data byte contains the ACK_RSSI (assuming the datalength is valid)
+    if (frame.len >= 1) {
+      _ackRSSI = -1 * frame.data[0]; //rssi was sent as single byte positive value, get the real value by * -1
+      frame.len -= 1;   // and compensate data length accordingly
+      memmove(frame.data, frame.data + 1, frame.len);
       // TomWS1: Now dither transmitLevel value (register update occurs later when transmitting);
       if (_targetRSSI != 0) {
         uint8_t maxLevel = _isRFM69HW ? 23 : 31;
@@ -149,12 +161,16 @@ bool RFM69_ATC::sendWithRetry(uint16_t toAddress, const void* buffer, uint8_t bu
     sentTime = millis();
     uint8_t maxLevel = _isRFM69HW ? 23 : 31;
     while (millis() - sentTime < retryWaitTime)
-      if (ACKReceived(toAddress)) return true;
+      if (ACKReceived(toAddress)) {
+        countAck(i, sentTime);
+        return true;
+      }
     if (_powerLevel < maxLevel) {
       setPowerLevel(_powerLevel + _transmitLevelStep);
     }
   }
 
+  _stats.retryFailures++;
   return false;
 }
 
@@ -34,10 +34,11 @@
 
 class RFM69_ATC: public RFM69 {
   public:
-    static volatile uint8_t ACK_RSSI_REQUESTED;  // new flag in CTL byte to request RSSI with ACK (could potentially be merged with ACK_REQUESTED)
+    volatile uint8_t ACK_RSSI_REQUESTED;  // new flag in CTL byte to request RSSI with ACK (could potentially be merged with ACK_REQUESTED)
 
     RFM69_ATC(uint8_t slaveSelectPin=RF69_SPI_CS, uint8_t interruptPin=RF69_IRQ_PIN, bool isRFM69HW=false, SPIClass *spi=nullptr) :
       RFM69(slaveSelectPin, interruptPin, isRFM69HW, spi) {
+      ACK_RSSI_REQUESTED = 0;
     }
 
     bool initialize(uint8_t freqBand, uint16_t ID, uint8_t networkID=1);
@@ -50,9 +51,11 @@ class RFM69_ATC: public RFM69 {
     uint8_t _transmitLevelStep;  // saved powerLevel in case we do auto power adjustment, this value gets dithered
 
   protected:
-    void interruptHook(uint8_t CTLbyte);
+    void interruptHook(RFM69Frame& frame);
     void sendFrame(uint16_t toAddress, const void* buffer, uint8_t size, bool requestACK=false, bool sendACK=false);  // Need this one to match the RFM69 prototype.
     void sendFrame(uint16_t toAddress, const void* buffer, uint8_t size, bool requestACK, bool sendACK, bool sendRSSI, int16_t lastRSSI);
+    void startFrame(uint16_t toAddress, const void* buffer, uint8_t size, bool requestACK=false, bool sendACK=false);
+    void startFrame(uint16_t toAddress, const void* buffer, uint8_t size, bool requestACK, bool sendACK, bool sendRSSI, int16_t lastRSSI);
     void receiveBegin();
 
     int16_t _ackRSSI;         // this contains the RSSI our destination Ack'd back to us (if we enabledAutoPower)
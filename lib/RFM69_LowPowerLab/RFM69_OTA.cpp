@@ -510,8 +510,8 @@ uint8_t sendHEXPacket(RFM69& radio, uint16_t targetID, uint8_t* sendBuf, uint8_t
           radio.DATA[ackLen-2]=='O' && radio.DATA[ackLen-1]=='K')
       {
         uint16_t tmp=0;
-#if defined(__arm__)
-        // On the ARM platform, uint16_t = short unsigned int, so %hu formatting is needed:
+#if defined(__arm__) || !defined(__AVR__)
+        // On the ARM platform (and native/host builds), uint16_t = short unsigned int, so %hu formatting is needed:
         sscanf((const char*)radio.DATA, "FLX:%hu:OK", &tmp);
 #else
         // On the AVR platform, uint16_t = unsigned int, so %u formatting is needed:
@@ -0,0 +1,102 @@
+// **********************************************************************************
+// Discrete-event 915MHz channel, see RadioMedium.h
+// **********************************************************************************
+#include "RadioMedium.h"
+#include <ArduinoNative.h>
+#include <string.h>
+#include <algorithm>
+
+RadioMedium::RadioMedium(uint32_t seed, float packetErrorRate)
+  : _rng(seed), _noise(packetErrorRate), _nextId(1), _carriedUs(0) {
+}
+
+void RadioMedium::attach(RadioEndpoint* endpoint) {
+  _endpoints.push_back(endpoint);
+}
+
+// preamble + sync word + length byte + payload + CRC, no whitening/manchester overhead;
+// AES sends the bytes after the length byte in whole 16 byte blocks
+uint32_t RadioMedium::airtimeUs(uint32_t bitrate, uint16_t preambleBytes, uint8_t syncBytes, uint8_t len, bool crc, bool aes) {
+  uint32_t message = aes ? (len + 15) / 16 * 16 : len;
+  uint32_t bytes = preambleBytes + syncBytes + 1 + message + (crc ? 2 : 0);
+  return (uint32_t)((bytes * 8ULL * 1000000ULL + bitrate - 1) / bitrate);
+}
+
+uint32_t RadioMedium::transmit(RadioEndpoint* sender, uint32_t bitrate, uint32_t airtimeUs, int16_t rssi, const uint8_t* data, uint8_t len) {
+  std::shared_ptr<OnAir> onAir(new OnAir());
+  RadioFrame& frame = onAir->frame;
+  uint64_t now = ArduinoNative::now();
+  frame.id = _nextId++;
+  frame.sender = sender;
+  frame.bitrate = bitrate;
+  frame.start = now;
+  frame.end = now + airtimeUs;
+  _carriedUs += airtimeUs;
+  frame.rssi = rssi;
+  frame.collided = false;
+  frame.len = len > RADIO_MAX_FRAME - 1 ? RADIO_MAX_FRAME - 1 : len;
+  memcpy(frame.data, data, frame.len);
+
+  for (size_t i = 0; i < _onAir.size(); i++) {
+    _onAir[i]->frame.collided = true;
+    frame.collided = true;
+  }
+  for (size_t i = 0; i < _endpoints.size(); i++) {
+    RadioEndpoint* endpoint = _endpoints[i];
+    if (endpoint == sender) continue;
+    if (endpoint->listening(bitrate))
+      onAir->listeners.push_back(Listener{ endpoint, endpoint->rxEpoch() });
+    else if (_hook)
+      _hook(frame, endpoint, RADIO_NOT_LISTENING);
+  }
+
+  _onAir.push_back(onAir);
+  ArduinoNative::schedule(frame.end, [this, onAir]() { finish(onAir); });
+  return frame.id;
+}
+
+void RadioMedium::abort(uint32_t frameId) {
+  for (size_t i = 0; i < _onAir.size(); i++)
+    if (_onAir[i]->frame.id == frameId) _onAir[i]->frame.collided = true;
+}
+
+void RadioMedium::finish(std::shared_ptr<OnAir> onAir) {
+  _onAir.erase(std::find(_onAir.begin(), _onAir.end(), onAir));
+  const RadioFrame& frame = onAir->frame;
+  for (size_t i = 0; i < onAir->listeners.size(); i++) {
+    RadioEndpoint* endpoint = onAir->listeners[i].endpoint;
+    RadioOutcome outcome;
+    if (endpoint->rxEpoch() != onAir->listeners[i].epoch) outcome = RADIO_INTERRUPTED;
+    else if (frame.collided) outcome = RADIO_COLLISION;
+    else if (_noise(_rng)) outcome = RADIO_NOISE;
+    else outcome = endpoint->receive(frame) ? RADIO_DELIVERED : RADIO_OVERRUN;
+    if (_hook) _hook(frame, endpoint, outcome);
+  }
+}
+
+bool RadioMedium::channelBusy() {
+  uint64_t now = ArduinoNative::now();
+  for (size_t i = 0; i < _onAir.size(); i++)
+    if (_onAir[i]->frame.start + RADIO_SENSE_DELAY_US <= now) return true;
+  return false;
+}
+
+bool RadioMedium::syncMatched(RadioEndpoint* endpoint) {
+  uint64_t now = ArduinoNative::now();
+  for (size_t i = 0; i < _onAir.size(); i++) {
+    const OnAir& onAir = *_onAir[i];
+    if (onAir.frame.start + airtimeUs(onAir.frame.bitrate, 3, 2, 0, false, false) > now) continue; // preamble and sync
+    for (size_t j = 0; j < onAir.listeners.size(); j++)
+      if (onAir.listeners[j].endpoint == endpoint && onAir.listeners[j].epoch == endpoint->rxEpoch()) return true;
+  }
+  return false;
+}
+
+int16_t RadioMedium::channelRssi() {
+  uint64_t now = ArduinoNative::now();
+  int16_t rssi = RADIO_NOISE_DBM;
+  for (size_t i = 0; i < _onAir.size(); i++)
+    if (_onAir[i]->frame.start + RADIO_SENSE_DELAY_US <= now && _onAir[i]->frame.rssi > rssi)
+      rssi = _onAir[i]->frame.rssi;
+  return rssi;
+}
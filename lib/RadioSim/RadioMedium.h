@@ -0,0 +1,100 @@
+// **********************************************************************************
+// Discrete-event 915MHz channel shared by the simulated controller radio and hats
+// **********************************************************************************
+// - every endpoint hears every other endpoint (one stage, no hidden nodes)
+// - two frames that overlap in time corrupt each other at every receiver
+// - a receiver only gets a frame if it was listening on the same bitrate for
+//   the whole frame (leaving RX or transmitting part way through loses it)
+// - on top of that each delivery is dropped with the configured packet error rate
+// **********************************************************************************
+#ifndef RadioMedium_h
+#define RadioMedium_h
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <random>
+#include <vector>
+
+#define RADIO_MAX_FRAME      66  // FIFO size, including the length byte
+#define RADIO_SENSE_DELAY_US 100 // time before a new carrier shows up in a receiver's RSSI
+#define RADIO_NOISE_DBM    -100  // channel RSSI with nobody transmitting
+
+class RadioEndpoint;
+
+struct RadioFrame {
+  uint32_t id;
+  RadioEndpoint* sender;
+  uint32_t bitrate;
+  uint64_t start;
+  uint64_t end;
+  int16_t rssi;                    // dBm seen by the receivers
+  bool collided;
+  uint8_t len;                     // bytes following the length byte
+  uint8_t data[RADIO_MAX_FRAME];   // TARGETID, SENDERID, CTL byte, payload
+
+  uint8_t targetId() const { return data[0]; }
+  uint8_t senderId() const { return data[1]; }
+  uint8_t ctl() const { return data[2]; }
+  const uint8_t* payload() const { return data + 3; }
+  uint8_t payloadLen() const { return len < 3 ? 0 : len - 3; }
+};
+
+enum RadioOutcome {
+  RADIO_DELIVERED,
+  RADIO_NOT_LISTENING, // receiver was not in RX (or on another bitrate) when the frame started
+  RADIO_INTERRUPTED,   // receiver left RX before the frame ended
+  RADIO_COLLISION,
+  RADIO_NOISE,         // random packet error
+  RADIO_OVERRUN,       // receiver still held an unread frame
+  RADIO_OUTCOMES
+};
+
+class RadioEndpoint {
+  public:
+    virtual ~RadioEndpoint() {}
+    virtual bool listening(uint32_t bitrate) = 0; // receiver is armed on this bitrate right now
+    virtual uint32_t rxEpoch() = 0;               // must change every time the receiver leaves RX
+    virtual bool receive(const RadioFrame& frame) = 0; // false if there was no room for the frame
+};
+
+class RadioMedium {
+  public:
+    typedef std::function<void(const RadioFrame&, RadioEndpoint*, RadioOutcome)> OutcomeHook;
+
+    RadioMedium(uint32_t seed, float packetErrorRate);
+
+    void attach(RadioEndpoint* endpoint);
+    uint32_t transmit(RadioEndpoint* sender, uint32_t bitrate, uint32_t airtimeUs, int16_t rssi, const uint8_t* data, uint8_t len);
+    void abort(uint32_t frameId); // transmitter left TX early, whatever is on air is garbage
+    bool channelBusy(); // what an RSSI based carrier sense would report right now
+    int16_t channelRssi();
+    bool syncMatched(RadioEndpoint* endpoint); // endpoint is past the sync word of a frame it is receiving
+    void onOutcome(OutcomeHook hook) { _hook = hook; }
+    std::mt19937& rng() { return _rng; }
+
+    uint64_t carriedUs() const { return _carriedUs; } // airtime of every frame so far, overlaps counted twice
+
+    static uint32_t airtimeUs(uint32_t bitrate, uint16_t preambleBytes, uint8_t syncBytes, uint8_t len, bool crc, bool aes);
+
+  private:
+    struct Listener {
+      RadioEndpoint* endpoint;
+      uint32_t epoch;
+    };
+    struct OnAir {
+      RadioFrame frame;
+      std::vector<Listener> listeners;
+    };
+
+    void finish(std::shared_ptr<OnAir> onAir);
+
+    std::vector<RadioEndpoint*> _endpoints;
+    std::vector<std::shared_ptr<OnAir> > _onAir;
+    std::mt19937 _rng;
+    std::bernoulli_distribution _noise;
+    uint32_t _nextId;
+    OutcomeHook _hook;
+    uint64_t _carriedUs;
+};
+
+#endif
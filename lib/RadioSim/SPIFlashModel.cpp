@@ -0,0 +1,81 @@
+// **********************************************************************************
+// Winbond W25X40CL model, see SPIFlashModel.h
+// **********************************************************************************
+#include "SPIFlashModel.h"
+#include <SPIFlash.h>
+
+SPIFlashModel::SPIFlashModel(uint8_t csPin, uint16_t jedecID)
+  : memory(SPIFLASH_MODEL_SIZE, 0xFF), _jedecID(jedecID), _writeEnabled(false), _command(-1), _index(0), _addr(0) {
+  ArduinoNative::attachSPIDevice(csPin, this);
+}
+
+void SPIFlashModel::select() {
+  _command = -1;
+  _index = 0;
+  _addr = 0;
+}
+
+uint8_t SPIFlashModel::transfer(uint8_t out) {
+  if (_command < 0) {
+    _command = out;
+    if (_command == SPIFLASH_WRITEENABLE) _writeEnabled = true;
+    if (_command == SPIFLASH_WRITEDISABLE) _writeEnabled = false;
+    return 0;
+  }
+
+  uint16_t index = _index++;
+  switch (_command) {
+    case SPIFLASH_IDREAD:
+      return index == 0 ? _jedecID >> 8 : (index == 1 ? _jedecID & 0xFF : 0);
+    case SPIFLASH_STATUSREAD:
+      return _writeEnabled ? 0x02 : 0x00; // never busy
+    case SPIFLASH_MACREAD:
+      return index < 4 ? 0 : 0xA0 + index;
+    case SPIFLASH_ARRAYREADLOWFREQ:
+    case SPIFLASH_ARRAYREAD:
+    case SPIFLASH_BYTEPAGEPROGRAM:
+    case SPIFLASH_BLOCKERASE_4K:
+    case SPIFLASH_BLOCKERASE_32K:
+    case SPIFLASH_BLOCKERASE_64K:
+      if (index < 3) {
+        _addr = (_addr << 8) | out;
+        return 0;
+      }
+      if (_command == SPIFLASH_ARRAYREAD && index == 3) return 0; // dummy byte
+      if (_command == SPIFLASH_BYTEPAGEPROGRAM) {
+        if (_writeEnabled) {
+          uint32_t page = _addr & ~0xFFUL;
+          uint32_t addr = page | ((_addr + index - 3) & 0xFF); // wraps within the page
+          memory[addr % SPIFLASH_MODEL_SIZE] &= out;
+        }
+        return 0;
+      }
+      if (_command == SPIFLASH_ARRAYREAD || _command == SPIFLASH_ARRAYREADLOWFREQ) {
+        uint32_t offset = _command == SPIFLASH_ARRAYREAD ? index - 4 : index - 3;
+        return memory[(_addr + offset) % SPIFLASH_MODEL_SIZE];
+      }
+      return 0;
+    default:
+      return 0;
+  }
+}
+
+void SPIFlashModel::unselect() {
+  if (!_writeEnabled) return;
+  switch (_command) {
+    case SPIFLASH_BLOCKERASE_4K:  erase(_addr, 0x1000); break;
+    case SPIFLASH_BLOCKERASE_32K: erase(_addr, 0x8000); break;
+    case SPIFLASH_BLOCKERASE_64K: erase(_addr, 0x10000); break;
+    case SPIFLASH_CHIPERASE:
+    case 0xC7:                    erase(0, SPIFLASH_MODEL_SIZE); break;
+    case SPIFLASH_BYTEPAGEPROGRAM:
+    case SPIFLASH_STATUSWRITE:    break;
+    default: return;
+  }
+  _writeEnabled = false;
+}
+
+void SPIFlashModel::erase(uint32_t addr, uint32_t size) {
+  addr &= ~(size - 1);
+  for (uint32_t i = 0; i < size && addr + i < SPIFLASH_MODEL_SIZE; i++) memory[addr + i] = 0xFF;
+}
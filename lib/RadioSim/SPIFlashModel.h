@@ -0,0 +1,32 @@
+// **********************************************************************************
+// Winbond W25X40CL (4Mbit) model on the simulated SPI bus
+// Covers the command set used by the SPIFlash library; program/erase are instant.
+// **********************************************************************************
+#ifndef SPIFlashModel_h
+#define SPIFlashModel_h
+#include <ArduinoNative.h>
+#include <vector>
+
+#define SPIFLASH_MODEL_SIZE 0x80000 // 512KB
+
+class SPIFlashModel : public SPIDevice {
+  public:
+    SPIFlashModel(uint8_t csPin, uint16_t jedecID = 0xEF30);
+
+    void select();
+    uint8_t transfer(uint8_t out);
+    void unselect();
+
+    std::vector<uint8_t> memory;
+
+  private:
+    void erase(uint32_t addr, uint32_t size);
+
+    uint16_t _jedecID;
+    bool _writeEnabled;
+    int16_t _command; // -1 until the first byte of a transaction
+    uint16_t _index;  // bytes received after the command byte
+    uint32_t _addr;
+};
+
+#endif
@@ -0,0 +1,203 @@
+// **********************************************************************************
+// SX1231/RFM69 register model, see SX1231Model.h
+// **********************************************************************************
+#include "SX1231Model.h"
+#include <Arduino.h>
+#include <RFM69registers.h>
+#include <string.h>
+
+#define MODE_SLEEP   0
+#define MODE_STANDBY 1
+#define MODE_SYNTH   2
+#define MODE_TX      3
+#define MODE_RX      4
+
+#define SX1231_TEMP2_25C 140 // raw REG_TEMP2 that RFM69::readTemperature() turns into ~25C
+
+SX1231Model::SX1231Model(RadioMedium& medium, uint8_t csPin, uint8_t irqPin, int16_t txRssi)
+  : framesSent(0), framesLoaded(0), framesDrained(0), framesDiscarded(0),
+    _medium(medium), _irqPin(irqPin), _txRssi(txRssi), _fifoLen(0), _fifoRead(0),
+    _payloadReady(false), _packetSent(false), _mode(MODE_STANDBY), _rxEpoch(0),
+    _txGeneration(0), _txFrameId(0), _rssi(RADIO_NOISE_DBM), _haveAddress(false), _addr(0), _write(false) {
+  memset(_regs, 0, sizeof(_regs));
+  _regs[REG_OPMODE] = RF_OPMODE_STANDBY;
+  _regs[REG_BITRATEMSB] = 0x1A; // 4.8kbps
+  _regs[REG_BITRATELSB] = 0x0B;
+  _regs[REG_VERSION] = 0x24;
+  _regs[REG_PREAMBLELSB] = 3;
+  _regs[REG_SYNCCONFIG] = 0x98; // sync on, 4 bytes
+  _regs[REG_PACKETCONFIG1] = 0x10; // fixed length, CRC on
+  memset(&_loaded, 0, sizeof(_loaded));
+  ArduinoNative::attachSPIDevice(csPin, this);
+  medium.attach(this);
+}
+
+uint32_t SX1231Model::bitrate() {
+  uint16_t divider = ((uint16_t)_regs[REG_BITRATEMSB] << 8) | _regs[REG_BITRATELSB];
+  return divider ? 32000000UL / divider : 0;
+}
+
+//=============================================================================
+// SPI
+//=============================================================================
+void SX1231Model::select() {
+  _haveAddress = false;
+}
+
+uint8_t SX1231Model::transfer(uint8_t out) {
+  if (!_haveAddress) {
+    _haveAddress = true;
+    _addr = out & 0x7F;
+    _write = out & 0x80;
+    return 0;
+  }
+  uint8_t in = 0;
+  if (_write) writeRegister(_addr, out);
+  else in = readRegister(_addr);
+  if (_addr != REG_FIFO) _addr = (_addr + 1) & 0x7F; // auto-increment everywhere but the FIFO
+  return in;
+}
+
+void SX1231Model::unselect() {
+  _haveAddress = false;
+}
+
+uint8_t SX1231Model::readRegister(uint8_t addr) {
+  switch (addr) {
+    case REG_FIFO: {
+      if (_fifoRead >= _fifoLen) return 0;
+      uint8_t value = _fifo[_fifoRead++];
+      if (_fifoRead == _fifoLen) {
+        if (_payloadReady) {
+          framesDrained++;
+          if (_drainedHook) _drainedHook(_loaded);
+        }
+        _payloadReady = false;
+        _fifoLen = _fifoRead = 0;
+        updateDio0();
+      }
+      return value;
+    }
+    case REG_OSC1:
+      return _regs[addr] | RF_OSC1_RCCAL_DONE;
+    case REG_RSSICONFIG:
+      return RF_RSSI_DONE;
+    case REG_RSSIVALUE:
+      if (_mode == MODE_RX && !_payloadReady) _rssi = _medium.channelRssi();
+      return (uint8_t)(-2 * _rssi);
+    case REG_IRQFLAGS1:
+      return RF_IRQFLAGS1_MODEREADY | (_mode == MODE_RX ? RF_IRQFLAGS1_RXREADY : 0) | (_mode == MODE_TX ? RF_IRQFLAGS1_TXREADY : 0)
+           | (_mode == MODE_RX && !_payloadReady && _medium.syncMatched(this) ? RF_IRQFLAGS1_SYNCADDRESSMATCH : 0);
+    case REG_IRQFLAGS2:
+      return (_fifoRead < _fifoLen ? RF_IRQFLAGS2_FIFONOTEMPTY : 0) | (_packetSent ? RF_IRQFLAGS2_PACKETSENT : 0)
+           | (_payloadReady ? RF_IRQFLAGS2_PAYLOADREADY | RF_IRQFLAGS2_CRCOK : 0);
+    case REG_TEMP1:
+      return 0; // measurement finishes instantly
+    case REG_TEMP2:
+      return SX1231_TEMP2_25C;
+    default:
+      return _regs[addr];
+  }
+}
+
+void SX1231Model::writeRegister(uint8_t addr, uint8_t value) {
+  switch (addr) {
+    case REG_FIFO:
+      if (_fifoLen < RADIO_MAX_FRAME) _fifo[_fifoLen++] = value;
+      return;
+    case REG_OPMODE:
+      _regs[addr] = value & ~RF_OPMODE_LISTENABORT;
+      setMode((value >> 2) & 0x07);
+      return;
+    case REG_IRQFLAGS2:
+      if (value & RF_IRQFLAGS2_FIFOOVERRUN) clearFifo();
+      return;
+    case REG_PACKETCONFIG2:
+      _regs[addr] = value & ~RF_PACKET2_RXRESTART;
+      if ((value & RF_PACKET2_RXRESTART) && _mode == MODE_RX) {
+        clearFifo();
+        _rxEpoch++;
+      }
+      return;
+    case REG_DIOMAPPING1:
+      _regs[addr] = value;
+      updateDio0();
+      return;
+    default:
+      _regs[addr] = value;
+  }
+}
+
+void SX1231Model::clearFifo() {
+  if (_payloadReady) framesDiscarded++;
+  _payloadReady = false;
+  _fifoLen = _fifoRead = 0;
+  updateDio0();
+}
+
+//=============================================================================
+// modes, TX and RX
+//=============================================================================
+void SX1231Model::setMode(uint8_t mode) {
+  if (mode == _mode) return;
+  if (_mode == MODE_RX) _rxEpoch++;
+  if (_mode == MODE_TX) {
+    if (_txFrameId) _medium.abort(_txFrameId);
+    _txFrameId = 0;
+    _packetSent = false;
+    _txGeneration++;
+  }
+  _mode = mode;
+  if (_mode == MODE_TX) {
+    uint32_t generation = ++_txGeneration;
+    ArduinoNative::schedule(ArduinoNative::now() + SX1231_TX_RAMP_US, [this, generation]() { startTransmit(generation); });
+  }
+  updateDio0();
+}
+
+void SX1231Model::startTransmit(uint32_t generation) {
+  if (generation != _txGeneration || _fifoLen == 0) return;
+  uint8_t len = _fifo[0];
+  if (len > _fifoLen - 1) len = _fifoLen - 1;
+  uint16_t preamble = ((uint16_t)_regs[REG_PREAMBLEMSB] << 8) | _regs[REG_PREAMBLELSB];
+  uint8_t sync = (_regs[REG_SYNCCONFIG] & RF_SYNC_ON) ? ((_regs[REG_SYNCCONFIG] >> 3) & 0x07) + 1 : 0;
+  bool crc = _regs[REG_PACKETCONFIG1] & RF_PACKET1_CRC_ON;
+  bool aes = _regs[REG_PACKETCONFIG2] & RF_PACKET2_AES_ON;
+  uint32_t airtime = RadioMedium::airtimeUs(bitrate(), preamble, sync, len, crc, aes);
+  _txFrameId = _medium.transmit(this, bitrate(), airtime, _txRssi, _fifo + 1, len);
+  framesSent++;
+  ArduinoNative::schedule(ArduinoNative::now() + airtime, [this, generation]() { finishTransmit(generation); });
+}
+
+void SX1231Model::finishTransmit(uint32_t generation) {
+  if (generation != _txGeneration) return;
+  _txFrameId = 0;
+  _packetSent = true;
+  _fifoLen = _fifoRead = 0;
+  updateDio0();
+}
+
+bool SX1231Model::listening(uint32_t rate) {
+  return _mode == MODE_RX && rate == bitrate();
+}
+
+bool SX1231Model::receive(const RadioFrame& frame) {
+  if (_payloadReady) return false;
+  _fifo[0] = frame.len;
+  memcpy(_fifo + 1, frame.data, frame.len);
+  _fifoLen = frame.len + 1;
+  _fifoRead = 0;
+  _payloadReady = true;
+  _rssi = frame.rssi;
+  _loaded = frame;
+  framesLoaded++;
+  updateDio0();
+  return true;
+}
+
+// DIO0: PayloadReady/CrcOk in RX, PacketSent in TX
+void SX1231Model::updateDio0() {
+  uint8_t mapping = (_regs[REG_DIOMAPPING1] >> 6) & 0x03;
+  bool level = (_mode == MODE_RX && mapping <= 1 && _payloadReady) || (_mode == MODE_TX && mapping == 0 && _packetSent);
+  ArduinoNative::setPin(_irqPin, level ? HIGH : LOW);
+}
@@ -0,0 +1,76 @@
+// **********************************************************************************
+// SX1231/RFM69 register model on the simulated SPI bus
+// **********************************************************************************
+// Enough of the chip for the LowPowerLab driver in packet mode:
+// - register file with address auto-increment, FIFO access through REG_FIFO
+// - sleep/standby/FS/TX/RX modes, TX of the FIFO contents after the PA ramp
+// - PayloadReady/PacketSent/FifoNotEmpty/SyncAddressMatch flags, RxRestart, FIFO overrun clear
+// - DIO0 mapped per RegDioMapping1 and driven onto the MCU interrupt pin
+// - RSSI, temperature and RC calibration reads
+// AES, address filtering, listen mode and OOK are not modelled.
+// **********************************************************************************
+#ifndef SX1231Model_h
+#define SX1231Model_h
+#include <ArduinoNative.h>
+#include "RadioMedium.h"
+#include <functional>
+
+#define SX1231_TX_RAMP_US 120 // standby -> first preamble bit (PLL lock + PA ramp)
+
+class SX1231Model : public SPIDevice, public RadioEndpoint {
+  public:
+    SX1231Model(RadioMedium& medium, uint8_t csPin, uint8_t irqPin, int16_t txRssi = -50);
+
+    // SPIDevice
+    void select();
+    uint8_t transfer(uint8_t out);
+    void unselect();
+
+    // RadioEndpoint
+    bool listening(uint32_t bitrate);
+    uint32_t rxEpoch() { return _rxEpoch; }
+    bool receive(const RadioFrame& frame);
+
+    uint32_t bitrate();
+    uint8_t reg(uint8_t addr) { return _regs[addr & 0x7F]; }
+    void onDrained(std::function<void(const RadioFrame&)> hook) { _drainedHook = hook; }
+
+    uint32_t framesSent;
+    uint32_t framesLoaded;    // made it into the FIFO
+    uint32_t framesDrained;   // read out of the FIFO by the driver
+    uint32_t framesDiscarded; // cleared by RxRestart/overrun before being read
+
+  private:
+    uint8_t readRegister(uint8_t addr);
+    void writeRegister(uint8_t addr, uint8_t value);
+    void setMode(uint8_t mode);
+    void startTransmit(uint32_t generation);
+    void finishTransmit(uint32_t generation);
+    void clearFifo();
+    void updateDio0();
+
+    RadioMedium& _medium;
+    uint8_t _irqPin;
+    int16_t _txRssi;
+    uint8_t _regs[0x80];
+    uint8_t _fifo[RADIO_MAX_FRAME];
+    uint8_t _fifoLen;
+    uint8_t _fifoRead;
+    bool _payloadReady;
+    bool _packetSent;
+    uint8_t _mode;
+    uint32_t _rxEpoch;
+    uint32_t _txGeneration;
+    uint32_t _txFrameId;
+    int16_t _rssi;
+    RadioFrame _loaded;
+
+    // SPI access state
+    bool _haveAddress;
+    uint8_t _addr;
+    bool _write;
+
+    std::function<void(const RadioFrame&)> _drainedHook;
+};
+
+#endif
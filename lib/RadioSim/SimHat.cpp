@@ -0,0 +1,198 @@
+// **********************************************************************************
+// Behavioural antler hat model, see SimHat.h
+// **********************************************************************************
+#include "SimHat.h"
+#include <ArduinoNative.h>
+#include <AntlerProtocol.h>
+#include <RFM69.h>
+#include <string.h>
+
+SimHat::SimHat(RadioMedium& medium, SimStats& stats, uint8_t nodeId, const SimHatConfig& config)
+  : _medium(medium), _stats(stats), _nodeId(nodeId), _config(config), _state(0), _antlerState(false), _groups(0),
+    _telemetryChannel(false), _transmitting(false), _rxEpoch(0), _csmaStart(0), _csmaWaiting(false),
+    _backoffExponent(0) {
+  std::uniform_int_distribution<int> rssi(-85, -45);
+  _rssi = rssi(medium.rng());
+  std::uniform_int_distribution<uint32_t> offset;
+  std::uniform_real_distribution<double> ppm(-config.driftPpm, config.driftPpm);
+  _clockOffset = offset(medium.rng());
+  _clockPpm = ppm(medium.rng());
+  medium.attach(this);
+}
+
+void SimHat::start() {
+  pollProfile();
+  if (_config.telemetryIntervalMs == 0) return;
+  std::uniform_int_distribution<uint32_t> offset(0, _config.telemetryIntervalMs * 1000UL);
+  scheduleTelemetry(offset(_medium.rng()));
+}
+
+void SimHat::scheduleTelemetry(uint32_t delayUs) {
+  ArduinoNative::schedule(ArduinoNative::now() + delayUs, [this]() {
+    sendTelemetry();
+    uint32_t interval = _config.telemetryIntervalMs * 1000UL;
+    std::uniform_int_distribution<uint32_t> jitter(interval - interval / 10, interval + interval / 10);
+    scheduleTelemetry(jitter(_medium.rng()));
+  });
+}
+
+// A slotted answer only goes out if the radio is free right away, else the slot is lost
+void SimHat::sendTelemetry(TelemetryReason reason) {
+  bool slotted = reason == TELEMETRY_SLOT;
+  if (slotted ? _transmitting || _csmaWaiting : reason == TELEMETRY_OWN && _pollSlot.quiet(localMicros())) return;
+  ToControllersPayload payload;
+  payload.nodeId = _nodeId;
+  payload.version = ANTLER_WIRE_VERSION;
+  payload.state = _state;
+  payload.antlerState = _antlerState;
+  payload.vcc = 3.7f + (_nodeId % 5) * 0.1f;
+  payload.temperature = 25;
+  _cues.report(payload);
+  uint8_t frame[ANTLER_TELEMETRY_LEN];
+  queue(_config.controllerId, 0, frame, antlerEncodeTelemetry(payload, frame), slotted, true, slotted);
+  _stats.telemetrySent();
+}
+
+void SimHat::pollProfile() {
+  uint8_t profile;
+  if (_profile.poll(_clock, localMicros(), profile)) _config.bitrate = RFM69::profileBitrate(profile);
+  ArduinoNative::schedule(ArduinoNative::now() + SIMHAT_PROFILE_POLL_US, [this]() { pollProfile(); });
+}
+
+uint32_t SimHat::localMicros() const {
+  uint64_t now = ArduinoNative::now();
+  return _clockOffset + (uint32_t)(now + (int64_t)(now * _clockPpm * 1e-6));
+}
+
+//=============================================================================
+// receive side
+//=============================================================================
+bool SimHat::listening(uint32_t bitrate) {
+  return !_transmitting && bitrate == _config.bitrate;
+}
+
+bool SimHat::receive(const RadioFrame& frame) {
+  if (frame.targetId() != _nodeId && frame.targetId() != RF69_BROADCAST_ADDR) return true;
+
+  if ((frame.ctl() & RFM69_CTL_REQACK) && frame.targetId() == _nodeId)
+    queue(frame.senderId(), RFM69_CTL_SENDACK, 0, 0, true);
+
+  if (frame.senderId() != _config.controllerId) return true;
+  if (frame.targetId() == _nodeId && antlerDecodeGroups(frame.payload(), frame.payloadLen(), _groups)) return true;
+
+  uint8_t slot;
+  if (frame.targetId() == _nodeId && antlerDecodeSlot(frame.payload(), frame.payloadLen(), slot)) {
+    _pollSlot.assign(slot);
+    return true;
+  }
+  if (frame.targetId() == _nodeId && antlerDecodeStatus(frame.payload(), frame.payloadLen())) {
+    sendTelemetry(TELEMETRY_STATUS);
+    return true;
+  }
+  AntlerPollPayload poll;
+  if (antlerDecodePoll(frame.payload(), frame.payloadLen(), poll)) {
+    if (_pollSlot.poll(poll, _nodeId, localMicros())) {
+      uint32_t wait = _pollSlot.waitUs(localMicros());
+      ArduinoNative::schedule(ArduinoNative::now() + wait / (1 + _clockPpm * 1e-6), [this]() {
+        if (_pollSlot.due(localMicros())) sendTelemetry(TELEMETRY_SLOT);
+      });
+    }
+    return true;
+  }
+
+  AntlerSyncPayload sync;
+  if (antlerDecodeSync(frame.payload(), frame.payloadLen(), sync)) {
+    _clock.beacon(sync, localMicros()); // receive() runs at PayloadReady
+    _profile.beacon(sync, localMicros());
+    _telemetryChannel = sync.telemetryUse;
+    return true;
+  }
+
+  ToAntlersPayload cue;
+  if (antlerDecodeGo(frame.payload(), frame.payloadLen(), slot)) {
+    if (_armed.go(slot, cue)) act(cue);
+    return true;
+  }
+  if (antlerDecodeArm(frame.payload(), frame.payloadLen(), frame.senderId(), slot, cue)) {
+    if (cue.seqUse) _cues.heard(cue.seq);
+    if (antlerInGroup(_groups, cue.group)) _armed.arm(slot, cue);
+    return true;
+  }
+
+  if (!antlerDecodeCue(frame.payload(), frame.payloadLen(), frame.senderId(), cue)) return true;
+  if (cue.seqUse) _cues.heard(cue.seq);
+  if (antlerInGroup(_groups, cue.group) && (!cue.seqUse || _cues.isNew(cue.seq))) {
+    if (cue.seqUse) _cues.applied(cue.seq);
+    uint32_t wait = _clock.synced() && cue.atUse ? _clock.waitUs(cue, localMicros()) : cue.fireInMs * 1000UL;
+    if (wait) ArduinoNative::schedule(ArduinoNative::now() + wait / (1 + _clockPpm * 1e-6), [this, cue]() { act(cue); });
+    else act(cue);
+  }
+  return true;
+}
+
+void SimHat::act(const ToAntlersPayload& cue) {
+  _state = cue.state;
+  if (cue.antlerStateUse) _antlerState = cue.antlerState;
+  _stats.cueDecoded(_nodeId, cue.state);
+  if (_config.replyDelayMs)
+    ArduinoNative::schedule(ArduinoNative::now() + _config.replyDelayMs * 1000UL, [this]() { sendTelemetry(); });
+}
+
+//=============================================================================
+// transmit side
+//=============================================================================
+void SimHat::queue(uint8_t target, uint8_t ctl, const void* payload, uint8_t len, bool urgent, bool telemetry, bool slotted) {
+  Outgoing frame;
+  frame.medium = telemetry && _telemetryChannel && _config.telemetryMedium ? _config.telemetryMedium : &_medium;
+  frame.slotted = slotted;
+  frame.len = len + 3;
+  frame.data[0] = target;
+  frame.data[1] = _nodeId;
+  frame.data[2] = ctl;
+  if (len) memcpy(frame.data + 3, payload, len);
+  if (urgent) _outgoing.push_front(frame);
+  else _outgoing.push_back(frame);
+  if (slotted) {
+    _csmaWaiting = true; // the caller made sure the radio was idle
+    attemptSend();
+  }
+  else if (!_transmitting && !_csmaWaiting) startCsma();
+}
+
+// the head frame starts waiting for the channel: 0 to 2^csmaMinBE-1 slots, then a listen
+void SimHat::startCsma() {
+  _csmaWaiting = true;
+  _csmaStart = ArduinoNative::now();
+  _backoffExponent = _config.csmaMinBE;
+  uint32_t slots = _config.tightCsma ? 0 : _medium.rng()() & ((1U << _backoffExponent) - 1);
+  if (slots == 0) attemptSend();
+  else ArduinoNative::schedule(ArduinoNative::now() + slots * RF69_CSMA_SLOT_US, [this]() { attemptSend(); });
+}
+
+void SimHat::attemptSend() {
+  if (!_outgoing.front().slotted && _outgoing.front().medium->channelBusy() && ArduinoNative::now() - _csmaStart < SIMHAT_CSMA_LIMIT_US) {
+    uint32_t waitUs = SIMHAT_CSMA_POLL_US;
+    if (!_config.tightCsma) {
+      if (_backoffExponent < _config.csmaMaxBE) _backoffExponent++;
+      waitUs = (1 + (_medium.rng()() & ((1U << _backoffExponent) - 1))) * RF69_CSMA_SLOT_US;
+    }
+    ArduinoNative::schedule(ArduinoNative::now() + waitUs, [this]() { attemptSend(); });
+    return;
+  }
+  _csmaWaiting = false;
+  _transmitting = true;
+  _rxEpoch++;
+  ArduinoNative::schedule(ArduinoNative::now() + SIMHAT_TX_RAMP_US, [this]() {
+    Outgoing frame = _outgoing.front();
+    _outgoing.pop_front();
+    uint32_t airtime = RadioMedium::airtimeUs(_config.bitrate, 3, 2, frame.len, true, true); // hats encrypt like the controller
+    frame.medium->transmit(this, _config.bitrate, airtime, _rssi, frame.data, frame.len);
+    ArduinoNative::schedule(ArduinoNative::now() + airtime, [this]() { finishSend(); });
+  });
+}
+
+void SimHat::finishSend() {
+  _transmitting = false;
+  _rxEpoch++;
+  if (!_outgoing.empty()) startCsma();
+}
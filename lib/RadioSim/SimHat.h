@@ -0,0 +1,111 @@
+// **********************************************************************************
+// Behavioural model of an antler hat for the native simulation
+// **********************************************************************************
+// Speaks the same frames as a hat running the LowPowerLab driver (TARGETID,
+// SENDERID, CTL byte, payload) but is event driven instead of running a sketch:
+// - decodes ANTLER_MSG_CUE cues addressed to it or broadcast, ACKs on request
+// - keeps the group membership pushed with ANTLER_MSG_GROUPS and ignores other groups' cues
+// - tracks numbered broadcast cues with AntlerCueTracker and reports missed ones
+// - keeps network time from ANTLER_MSG_SYNC beacons with AntlerClock, on a local clock
+//   with its own offset and up to driftPpm of crystal error
+// - follows radio profile switches announced on beacons with AntlerProfileSwitch,
+//   polled every SIMHAT_PROFILE_POLL_US like a sketch's loop() would
+// - stores cues armed with ANTLER_MSG_ARM and acts on them when their ANTLER_MSG_GO arrives
+// - acts on a cue at its atMicros once synced, else fireInMs after receiving it, once
+//   per seq however many copies arrive
+// - reports ANTLER_MSG_TELEMETRY periodically and after each cue, on telemetryMedium
+//   once beacons carry ANTLER_SYNC_TELEMETRY (deaf to the cue channel meanwhile)
+// - answers ANTLER_MSG_POLL sweeps in its slot with AntlerPollSlot, by node ID or as
+//   assigned with ANTLER_MSG_SLOT, without carrier sense; while polls keep coming it
+//   sends no other telemetry
+// - answers ANTLER_MSG_STATUS requests with telemetry, quiet or not
+// - transmits with the driver's carrier sense: back off a random number of
+//   RF69_CSMA_SLOT_US slots, listen, and on a busy channel double the window and back
+//   off again, until the channel is free (or RF69_CSMA_LIMIT_MS runs out); with
+//   tightCsma it polls RSSI back to back instead, like the driver used to
+// **********************************************************************************
+#ifndef SimHat_h
+#define SimHat_h
+#include <stdint.h>
+#include <deque>
+#include <AntlerProtocol.h>
+#include "RadioMedium.h"
+#include "SimStats.h"
+
+#define SIMHAT_CSMA_POLL_US   60 // one canSend()/receiveDone() round trip
+#define SIMHAT_CSMA_LIMIT_US  1000000UL
+#define SIMHAT_TX_RAMP_US     120
+#define SIMHAT_PROFILE_POLL_US 1000
+
+struct SimHatConfig {
+  uint8_t controllerId;
+  uint32_t bitrate;
+  uint32_t telemetryIntervalMs; // 0 = only report after cues
+  uint16_t replyDelayMs;        // time to act on a cue before reporting back
+  float driftPpm;               // each hat's crystal is off by up to this much
+  RadioMedium* telemetryMedium; // ANTLER_TELEMETRY_FREQUENCY channel, nullptr = not simulated
+  uint8_t csmaMinBE;            // RFM69::setCsmaBackoff()
+  uint8_t csmaMaxBE;
+  bool tightCsma;
+};
+
+class SimHat : public RadioEndpoint {
+  public:
+    SimHat(RadioMedium& medium, SimStats& stats, uint8_t nodeId, const SimHatConfig& config);
+    void start();
+
+    bool listening(uint32_t bitrate);
+    uint32_t rxEpoch() { return _rxEpoch; }
+    bool receive(const RadioFrame& frame);
+
+    uint8_t nodeId() const { return _nodeId; }
+    uint8_t state() const { return _state; }
+    uint16_t groups() const { return _groups; }
+    uint8_t profile() const { return _profile.profile(); }
+
+  private:
+    struct Outgoing {
+      RadioMedium* medium;
+      bool slotted; // a poll answer, sent without carrier sense
+      uint8_t len;
+      uint8_t data[RADIO_MAX_FRAME];
+    };
+
+    void queue(uint8_t target, uint8_t ctl, const void* payload, uint8_t len, bool urgent = false, bool telemetry = false,
+               bool slotted = false);
+    void startCsma();
+    void attemptSend();
+    void finishSend();
+    enum TelemetryReason { TELEMETRY_OWN, TELEMETRY_SLOT, TELEMETRY_STATUS };
+
+    void sendTelemetry(TelemetryReason reason = TELEMETRY_OWN);
+    void act(const ToAntlersPayload& cue);
+    void scheduleTelemetry(uint32_t delayUs);
+    uint32_t localMicros() const; // what micros() would return on this hat
+    void pollProfile();
+
+    RadioMedium& _medium;
+    SimStats& _stats;
+    uint8_t _nodeId;
+    SimHatConfig _config;
+    int16_t _rssi; // how loud this hat is at the controller
+    uint8_t _state;
+    bool _antlerState;
+    uint16_t _groups;
+    AntlerCueTracker _cues;
+    AntlerClock _clock;
+    AntlerArmedCues _armed;
+    AntlerProfileSwitch _profile;
+    AntlerPollSlot _pollSlot;
+    uint32_t _clockOffset; // local micros() at simulated time 0
+    double _clockPpm;
+    bool _telemetryChannel; // last beacon had ANTLER_SYNC_TELEMETRY
+    bool _transmitting;
+    uint32_t _rxEpoch;
+    uint64_t _csmaStart;
+    bool _csmaWaiting;
+    uint8_t _backoffExponent;
+    std::deque<Outgoing> _outgoing;
+};
+
+#endif
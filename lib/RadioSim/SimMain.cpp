@@ -0,0 +1,447 @@
+// **********************************************************************************
+// Entry point of the [env:native] build: runs the real controller sketch
+// (setup()/loop() from src/) against N simulated antler hats
+// **********************************************************************************
+// Usage: program [--hats N] [--seconds S] [--cue-ms MS] [--telemetry-ms MS]
+//                [--reply-ms MS] [--per P] [--seed N] [--first-hat ID]
+//                [--controller-id ID] [--fleet-ms MS] [--groups N] [--burst K] [--show]
+//                [--drift-ppm P] [--arm] [--go-copies N] [--profile P] [--profile-at S]
+//                [--min-be N] [--max-be N] [--tight-csma] [--poll-ms MS] [--poll-assigned]
+//                [--fleet-poll-ms MS] [--poll-window N] [--poll-timeout-ms MS] [--missing N]
+//                [--binary] [--dual] [--echo]
+// The host sends a broadcast SERIAL_CMD_CUE frame (states 1-9 in turn) to the
+// controller's serial port every --cue-ms; hats report every --telemetry-ms and --reply-ms after a cue.
+// With --show the same cues are uploaded as a show once and played back from the controller's flash.
+// With --fleet-ms the host also polls the fleet table for changed entries every MS.
+// Just before the end the host reads the driver counters with SERIAL_CMD_RADIO_STATS
+// the loop() profile with SERIAL_CMD_LOOP_STATS and each hat's airtime with SERIAL_CMD_AIRTIME.
+// With --binary the host switches the controller to SERIAL_OUTPUT_BINARY telemetry first.
+// With --groups N the hats are split round robin into N groups and each cue goes to the next group.
+// With --burst K every cue is sent as a burst of K copies (SERIAL_CUE_BURST). To measure the
+// miss rate against K without repairs, add --telemetry-ms 0 so hats only report after cues.
+// With --arm each cue is armed (SERIAL_CMD_ARM) one --cue-ms ahead and fired by a SERIAL_CMD_GO
+// at its time, sent as --go-copies (default 1) GO frames; not with --show.
+// With --profile P the host moves the network to radio profile P (RF69_PROFILE_*) at
+// --profile-at S seconds (default halfway); the last line shows how many hats followed.
+// With --dual the controller has its second radio (DUAL_RADIO) on a channel of its own
+// and hats send telemetry there once its beacons tell them to.
+// Hats back off like the driver (RFM69::setCsmaBackoff()) with windows of 2^--min-be up to
+// 2^--max-be slots; --tight-csma makes them poll RSSI back to back like the old driver.
+// With --poll-ms MS the host has the controller sweep every hat for telemetry every MS
+// (SERIAL_CMD_POLL), hat i in slot i, or with --poll-assigned in the slots it pushes with
+// SERIAL_CMD_SLOT, last hat first. Sweep results are frames, so they show with --binary.
+// With --fleet-poll-ms MS the host has the controller ask every hat for its status every
+// MS instead (SERIAL_CMD_FLEET_POLL), --poll-window (default 4) at a time with
+// --poll-timeout-ms (default 40) each; --missing N adds N node IDs past the last hat
+// that nobody answers for. Also results only with --binary.
+// Numbered cues that hats report missing are repaired, each repair shows on the "cue repairs"
+// line; runs past 65.5 s (--seconds 80 --per 0.05) cross the wrap of the 16 bit millis()
+// CueHistory ages cues by, and repairs must keep going after it.
+// With --drift-ppm P each hat's clock runs up to P ppm fast or slow (crystal error); the
+// "cue skew" line shows how closely the hats still act together.
+// **********************************************************************************
+#include <Arduino.h>
+#include <ArduinoNative.h>
+#include <AntlerProtocol.h>
+#include <SerialLink.h>
+#include <FleetTable.h>
+#include <CueBurst.h>
+#include <SyncBeacon.h>
+#include <TelemetryPoll.h>
+#include <FleetPoller.h>
+#include <RFM69.h>
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include "RadioMedium.h"
+#include "SX1231Model.h"
+#include "SPIFlashModel.h"
+#include "SimHat.h"
+#include "SimStats.h"
+
+#define SIM_LOOP_OVERHEAD_US 2 // call/return and the loop() preamble on AVR
+#define SIM_RADIO_IRQ_PIN    2
+#define SIM_TELEMETRY_CS     7 // TELEMETRY_CS/TELEMETRY_IRQ in the sketch
+#define SIM_TELEMETRY_IRQ_PIN 3
+#define SIM_SHOW_FRAME_US    2000 // host pacing between show upload frames, ~23 bytes at 115200
+#define SIM_CUE_MARGIN_US    100000 // no cues this close to the end, so each one can reach the hats
+#define SIM_GROUPS_FRAME_US  10000 // host pacing between SERIAL_CMD_GROUPS frames, one radio frame each
+#define SIM_STATS_BEFORE_END_US 100000 // SERIAL_CMD_RADIO_STATS goes out this long before the end, 20ms per radio,
+                                       // then SERIAL_CMD_LOOP_STATS halfway to the end and
+                                       // SERIAL_CMD_AIRTIME three quarters of the way
+
+void setup();
+void loop();
+
+struct SimOptions {
+  uint16_t hats = 36;
+  double seconds = 60;
+  uint32_t cueMs = 2000;
+  uint32_t telemetryMs = 5000;
+  uint16_t replyMs = 20;
+  float per = 0.01f;
+  uint32_t seed = 1;
+  uint8_t firstHat = 10;
+  uint8_t controllerId = 3;
+  uint32_t fleetMs = 0;
+  uint8_t groups = 0;
+  uint8_t burst = 0;
+  float driftPpm = 0;
+  uint8_t goCopies = 1;
+  int profile = -1;
+  double profileAt = -1;
+  bool arm = false;
+  bool show = false;
+  bool binary = false;
+  bool dual = false;
+  bool echo = false;
+  uint8_t minBE = RF69_CSMA_MIN_BE;
+  uint8_t maxBE = RF69_CSMA_MAX_BE;
+  bool tightCsma = false;
+  uint16_t pollMs = 0;
+  bool pollAssigned = false;
+  uint16_t fleetPollMs = 0;
+  uint8_t pollWindow = 4;
+  uint8_t pollTimeoutMs = 40;
+  uint8_t missing = 0;
+};
+
+static bool parseOptions(int argc, char** argv, SimOptions& options) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+    if (!strcmp(arg, "--echo")) { options.echo = true; continue; }
+    if (!strcmp(arg, "--show")) { options.show = true; continue; }
+    if (!strcmp(arg, "--arm")) { options.arm = true; continue; }
+    if (!strcmp(arg, "--binary")) { options.binary = true; continue; }
+    if (!strcmp(arg, "--dual")) { options.dual = true; continue; }
+    if (!strcmp(arg, "--tight-csma")) { options.tightCsma = true; continue; }
+    if (!strcmp(arg, "--poll-assigned")) { options.pollAssigned = true; continue; }
+    if (value == nullptr) return false;
+    i++;
+    if (!strcmp(arg, "--hats")) options.hats = atoi(value);
+    else if (!strcmp(arg, "--seconds")) options.seconds = atof(value);
+    else if (!strcmp(arg, "--cue-ms")) options.cueMs = atol(value);
+    else if (!strcmp(arg, "--telemetry-ms")) options.telemetryMs = atol(value);
+    else if (!strcmp(arg, "--reply-ms")) options.replyMs = atoi(value);
+    else if (!strcmp(arg, "--per")) options.per = atof(value);
+    else if (!strcmp(arg, "--seed")) options.seed = atol(value);
+    else if (!strcmp(arg, "--first-hat")) options.firstHat = atoi(value);
+    else if (!strcmp(arg, "--controller-id")) options.controllerId = atoi(value);
+    else if (!strcmp(arg, "--fleet-ms")) options.fleetMs = atol(value);
+    else if (!strcmp(arg, "--groups")) options.groups = atoi(value);
+    else if (!strcmp(arg, "--burst")) options.burst = atoi(value);
+    else if (!strcmp(arg, "--drift-ppm")) options.driftPpm = atof(value);
+    else if (!strcmp(arg, "--go-copies")) options.goCopies = atoi(value);
+    else if (!strcmp(arg, "--profile")) options.profile = atoi(value);
+    else if (!strcmp(arg, "--profile-at")) options.profileAt = atof(value);
+    else if (!strcmp(arg, "--min-be")) options.minBE = atoi(value);
+    else if (!strcmp(arg, "--max-be")) options.maxBE = atoi(value);
+    else if (!strcmp(arg, "--poll-ms")) options.pollMs = atoi(value);
+    else if (!strcmp(arg, "--fleet-poll-ms")) options.fleetPollMs = atoi(value);
+    else if (!strcmp(arg, "--poll-window")) options.pollWindow = atoi(value);
+    else if (!strcmp(arg, "--poll-timeout-ms")) options.pollTimeoutMs = atoi(value);
+    else if (!strcmp(arg, "--missing")) options.missing = atoi(value);
+    else return false;
+  }
+  return options.hats > 0 && options.firstHat + options.hats - 1 <= 255 && options.groups <= ANTLER_GROUPS &&
+         options.profile < RF69_PROFILES && options.minBE <= options.maxBE && options.maxBE <= RF69_CSMA_BE_LIMIT &&
+         (options.pollMs == 0 || (options.pollMs >= POLL_MIN_PERIOD_MS && options.hats <= 255)) &&
+         (options.fleetPollMs == 0 || (options.fleetPollMs >= POLLER_MIN_PERIOD_MS && options.pollWindow >= 1 &&
+                                       options.pollWindow <= POLLER_WINDOW_MAX && options.pollTimeoutMs >= POLLER_MIN_TIMEOUT_MS &&
+                                       options.firstHat + options.hats + options.missing <= 256));
+}
+
+static void hostSend(const uint8_t* data, uint8_t len) {
+  uint8_t frame[SERIAL_FRAME_MAX + 4];
+  ArduinoNative::serialHostWrite(frame, serialFrameEncode(data, len, frame));
+}
+
+// Cue n goes to group n % --groups + 1, or to every hat (0) without --groups
+static uint8_t cueGroup(const SimOptions& options, uint32_t n) {
+  return options.groups ? n % options.groups + 1 : 0;
+}
+
+static uint16_t cueHats(const SimOptions& options, uint8_t group) {
+  if (group == 0) return options.hats;
+  return options.hats / options.groups + (group <= options.hats % options.groups);
+}
+
+// Hat i joins group i % --groups + 1
+static void pushGroups(const SimOptions& options) {
+  for (uint16_t i = 0; i < options.hats; i++) {
+    ArduinoNative::schedule(ArduinoNative::now() + i * SIM_GROUPS_FRAME_US, [&options, i]() {
+      uint8_t groups[SERIAL_GROUPS_LEN] = { SERIAL_CMD_GROUPS, (uint8_t)(options.firstHat + i) };
+      serialPutShort(&groups[2], 1U << (i % options.groups));
+      hostSend(groups, sizeof(groups));
+    });
+  }
+}
+
+// Hat i gets slot hats-1-i with --poll-assigned, then the sweeps start, after the groups
+static void startPolling(const SimOptions& options) {
+  uint64_t t = ArduinoNative::now() + options.hats * SIM_GROUPS_FRAME_US * (options.groups != 0);
+  for (uint16_t i = 0; options.pollAssigned && i < options.hats; i++, t += SIM_GROUPS_FRAME_US) {
+    ArduinoNative::schedule(t, [&options, i]() {
+      uint8_t slot[SERIAL_SLOT_LEN] = { SERIAL_CMD_SLOT, (uint8_t)(options.firstHat + i), (uint8_t)(options.hats - 1 - i) };
+      hostSend(slot, sizeof(slot));
+    });
+  }
+  ArduinoNative::schedule(t, [&options]() {
+    uint8_t poll[SERIAL_POLL_LEN] = { SERIAL_CMD_POLL, options.firstHat, (uint8_t)options.hats,
+                                      (uint8_t)(options.pollAssigned ? SERIAL_POLL_ASSIGNED : 0) };
+    serialPutShort(&poll[4], options.pollMs);
+    hostSend(poll, sizeof(poll));
+  });
+}
+
+// Fleet polls cover the hats and --missing node IDs after them, after the groups
+static void startFleetPolling(const SimOptions& options) {
+  ArduinoNative::schedule(ArduinoNative::now() + options.hats * SIM_GROUPS_FRAME_US * (options.groups != 0), [&options]() {
+    uint8_t poll[SERIAL_FLEET_POLL_LEN] = { SERIAL_CMD_FLEET_POLL, options.firstHat, (uint8_t)(options.hats + options.missing),
+                                            options.pollWindow, options.pollTimeoutMs };
+    serialPutShort(&poll[5], options.fleetPollMs);
+    hostSend(poll, sizeof(poll));
+  });
+}
+
+// Arms cue n in slot n % ANTLER_ARM_SLOTS, for --arm
+static void armCue(const SimOptions& options, uint32_t n) {
+  uint8_t group = cueGroup(options, n);
+  uint8_t arm[SERIAL_ARM_LEN] = { SERIAL_CMD_ARM, (uint8_t)(n % ANTLER_ARM_SLOTS), group, (uint8_t)(n % 9 + 1),
+                                  (uint8_t)(group ? SERIAL_CUE_GROUP : 0) }; // sleepTime 0
+  hostSend(arm, sizeof(arm));
+}
+
+static void scheduleCue(SimStats& stats, const SimOptions& options, uint32_t count, uint64_t lastUs) {
+  uint64_t at = ArduinoNative::now() + options.cueMs * 1000ULL;
+  if (at > lastUs) return;
+  ArduinoNative::schedule(at, [&stats, &options, count, lastUs]() {
+    uint8_t state = count % 9 + 1;
+    uint8_t group = cueGroup(options, count);
+    if (options.arm) {
+      uint8_t go[SERIAL_GO_LEN] = { SERIAL_CMD_GO, (uint8_t)(count % ANTLER_ARM_SLOTS), options.goCopies };
+      hostSend(go, sizeof(go));
+      armCue(options, count + 1);
+    }
+    else {
+      uint8_t flags = (group ? SERIAL_CUE_GROUP : 0) | (options.burst ? SERIAL_CUE_BURST : 0);
+      uint8_t cue[SERIAL_CUE_LEN] = { SERIAL_CMD_CUE, group, state, flags }; // sleepTime 0
+      hostSend(cue, sizeof(cue));
+    }
+    stats.cueInjected(state, cueHats(options, group));
+    scheduleCue(stats, options, count + 1, lastUs);
+  });
+}
+
+static void scheduleFleetDump(SimStats& stats, uint32_t intervalMs, uint64_t lastUs) {
+  uint64_t at = ArduinoNative::now() + intervalMs * 1000ULL;
+  if (at > lastUs) return;
+  ArduinoNative::schedule(at, [&stats, intervalMs, lastUs]() {
+    uint8_t dump[SERIAL_FLEET_DUMP_LEN] = { SERIAL_CMD_FLEET_DUMP, SERIAL_FLEET_CHANGED };
+    hostSend(dump, sizeof(dump));
+    stats.fleetRequested();
+    scheduleFleetDump(stats, intervalMs, lastUs);
+  });
+}
+
+// Picks the reply frames out of the controller's serial output, which is mostly text
+class HostReplyReader {
+  public:
+    explicit HostReplyReader(SimStats& stats) : _stats(stats) {}
+
+    void feed(uint8_t c) {
+      if (c != SERIAL_FRAME_DELIM) {
+        _buf.push_back(c);
+        return;
+      }
+      if (!_buf.empty() && _buf.size() <= 255) {
+        uint8_t len = serialFrameDecode(_buf.data(), _buf.size());
+        if (len >= 2 && _buf[0] == SERIAL_RSP_FLEET)
+          _stats.fleetFrame((len - 2) / FLEET_RECORD_LEN, _buf[1] & SERIAL_FLEET_LAST, _buf[1] & SERIAL_FLEET_UNTRACKED);
+        else if (len >= 2 && _buf[0] == SERIAL_RSP_TELEMETRY)
+          _stats.telemetryFrame((len - 2) / SERIAL_TELEMETRY_RECORD_LEN, _buf[1]);
+        else if (_buf[0] == SERIAL_RSP_RADIO_STATS)
+          _stats.radioStatsFrame(_buf.data(), len);
+        else if (_buf[0] == SERIAL_RSP_LOOP_STATS)
+          _stats.loopStatsFrame(_buf.data(), len);
+        else if (_buf[0] == SERIAL_RSP_AIRTIME)
+          _stats.airtimeFrame(_buf.data(), len);
+        else if (_buf[0] == SERIAL_RSP_POLL)
+          _stats.pollFrame(_buf.data(), len);
+        else if (_buf[0] == SERIAL_RSP_FLEET_POLL)
+          _stats.fleetPollFrame(_buf.data(), len);
+      }
+      _buf.clear();
+    }
+
+  private:
+    SimStats& _stats;
+    std::vector<uint8_t> _buf;
+};
+
+// Uploads cues every intervalMs as a show, then starts it on a whole millisecond so the
+// controller's millis() origin matches the nominal cue times the stats are measured from.
+static void uploadShow(SimStats& stats, const SimOptions& options, uint64_t lastUs) {
+  uint32_t intervalMs = options.cueMs;
+  uint64_t t = ArduinoNative::now();
+  uint16_t cues = std::min<uint64_t>((lastUs - t) / (intervalMs * 1000ULL), 65535);
+  ArduinoNative::schedule(t, []() { uint8_t erase = SERIAL_CMD_SHOW_ERASE; hostSend(&erase, 1); });
+  for (uint16_t i = 0; i < cues; i++) {
+    t += SIM_SHOW_FRAME_US;
+    ArduinoNative::schedule(t, [&options, intervalMs, i]() {
+      uint8_t cue[SERIAL_SHOW_CUE_LEN] = { SERIAL_CMD_SHOW_CUE };
+      serialPutShort(&cue[1], i);
+      serialPutLong(&cue[3], (i + 1) * intervalMs);
+      cue[7] = cueGroup(options, i);
+      cue[8] = i % 9 + 1;
+      cue[9] = (cue[7] ? SERIAL_CUE_GROUP : 0) | (options.burst ? SERIAL_CUE_BURST : 0); // sleepTime 0
+      hostSend(cue, sizeof(cue));
+    });
+  }
+  t += SIM_SHOW_FRAME_US;
+  ArduinoNative::schedule(t, [cues]() {
+    uint8_t commit[SERIAL_SHOW_COMMIT_LEN] = { SERIAL_CMD_SHOW_COMMIT };
+    serialPutShort(&commit[1], cues);
+    hostSend(commit, sizeof(commit));
+  });
+
+  t = (t / 1000 + 2) * 1000 + 1; // just past a millis() tick
+  ArduinoNative::schedule(t, []() {
+    uint8_t start[SERIAL_SHOW_START_LEN] = { SERIAL_CMD_SHOW_START }; // from 0
+    hostSend(start, sizeof(start));
+  });
+  for (uint16_t i = 0; i < cues; i++) {
+    ArduinoNative::schedule(t - 1 + (i + 1) * intervalMs * 1000ULL, [&stats, &options, i]() {
+      stats.cueInjected(i % 9 + 1, cueHats(options, cueGroup(options, i)));
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  SimOptions options;
+  if (!parseOptions(argc, argv, options)) {
+    fprintf(stderr, "usage: %s [--hats N] [--seconds S] [--cue-ms MS] [--telemetry-ms MS] [--reply-ms MS]"
+                    " [--per P] [--seed N] [--first-hat ID] [--controller-id ID] [--fleet-ms MS] [--groups N] [--burst K] [--drift-ppm P]"
+                    " [--arm] [--go-copies N] [--profile P] [--profile-at S] [--min-be N] [--max-be N] [--tight-csma]"
+                    " [--poll-ms MS] [--poll-assigned] [--fleet-poll-ms MS] [--poll-window N] [--poll-timeout-ms MS] [--missing N]"
+                    " [--show] [--binary] [--dual] [--echo]\n", argv[0]);
+    return 2;
+  }
+  randomSeed(options.seed);
+
+  RadioMedium medium(options.seed, options.per);
+  SimStats stats;
+  SX1231Model radio(medium, SS, SIM_RADIO_IRQ_PIN);
+  SPIFlashModel flash(SS_FLASHMEM);
+  RadioMedium telemetryMedium(options.seed + 1, options.per);
+  std::unique_ptr<SX1231Model> telemetryRadio;
+  if (options.dual) telemetryRadio.reset(new SX1231Model(telemetryMedium, SIM_TELEMETRY_CS, SIM_TELEMETRY_IRQ_PIN));
+
+  uint32_t lastRepair = 0;
+  medium.onOutcome([&](const RadioFrame& frame, RadioEndpoint* receiver, RadioOutcome outcome) {
+    if (frame.sender == &radio) stats.cueFrameOutcome(outcome);
+    if (frame.sender == &radio && frame.id != lastRepair && frame.targetId() != RF69_BROADCAST_ADDR &&
+        antlerMessageType(frame.payload(), frame.payloadLen()) == ANTLER_MSG_CUE) { // one outcome per receiver, count the frame once
+      lastRepair = frame.id;
+      stats.cueRepaired(frame.start);
+    }
+    else if (receiver == &radio && frame.targetId() == options.controllerId) stats.telemetryOutcome(outcome);
+  });
+  radio.onDrained([&](const RadioFrame& frame) {
+    if (frame.sender != &radio && frame.targetId() == options.controllerId) stats.telemetryDrained();
+  });
+  if (telemetryRadio) {
+    telemetryMedium.onOutcome([&](const RadioFrame& frame, RadioEndpoint* receiver, RadioOutcome outcome) {
+      if (receiver == telemetryRadio.get() && frame.targetId() == options.controllerId) stats.telemetryOutcome(outcome);
+    });
+    telemetryRadio->onDrained([&](const RadioFrame& frame) {
+      if (frame.targetId() == options.controllerId) stats.telemetryDrained();
+    });
+  }
+  HostReplyReader replies(stats);
+  ArduinoNative::serialOnOutput([&](uint8_t c) {
+    replies.feed(c);
+    if (options.echo) putchar(c);
+  });
+
+  setup();
+
+  SimHatConfig config;
+  config.controllerId = options.controllerId;
+  config.bitrate = radio.bitrate();
+  config.telemetryIntervalMs = options.telemetryMs;
+  config.replyDelayMs = options.replyMs;
+  config.driftPpm = options.driftPpm;
+  config.telemetryMedium = telemetryRadio ? &telemetryMedium : nullptr;
+  config.csmaMinBE = options.minBE;
+  config.csmaMaxBE = options.maxBE;
+  config.tightCsma = options.tightCsma;
+  std::vector<std::unique_ptr<SimHat> > hats;
+  for (uint16_t i = 0; i < options.hats; i++) {
+    hats.push_back(std::unique_ptr<SimHat>(new SimHat(medium, stats, options.firstHat + i, config)));
+    hats.back()->start();
+  }
+
+  if (options.burst) {
+    uint8_t burst[SERIAL_BURST_LEN] = { SERIAL_CMD_BURST, options.burst, BURST_SPACING_MS };
+    hostSend(burst, sizeof(burst));
+  }
+  if (options.binary) {
+    uint8_t output[SERIAL_OUTPUT_LEN] = { SERIAL_CMD_OUTPUT, SERIAL_OUTPUT_BINARY };
+    hostSend(output, sizeof(output));
+  }
+
+  uint64_t start = ArduinoNative::now();
+  uint64_t end = start + (uint64_t)(options.seconds * 1e6);
+  if (options.groups) pushGroups(options);
+  if (options.pollMs) startPolling(options);
+  if (options.fleetPollMs) startFleetPolling(options);
+  if (options.cueMs && options.show) uploadShow(stats, options, end - SIM_CUE_MARGIN_US);
+  else if (options.cueMs) {
+    if (options.arm) ArduinoNative::schedule(start + options.hats * SIM_GROUPS_FRAME_US * (options.groups != 0),
+                                             [&options]() { armCue(options, 0); }); // after the groups are pushed
+    scheduleCue(stats, options, 0, end - SIM_CUE_MARGIN_US);
+  }
+  if (options.profile >= 0) {
+    double at = options.profileAt >= 0 ? options.profileAt : options.seconds / 2;
+    ArduinoNative::schedule(start + (uint64_t)(at * 1e6) - SYNC_SWITCH_MIN_MS * 1000ULL, [&options]() {
+      uint8_t profile[SERIAL_PROFILE_LEN] = { SERIAL_CMD_PROFILE, (uint8_t)options.profile };
+      serialPutShort(&profile[2], SYNC_SWITCH_MIN_MS);
+      hostSend(profile, sizeof(profile));
+    });
+  }
+  if (options.fleetMs) scheduleFleetDump(stats, options.fleetMs, end - SIM_CUE_MARGIN_US);
+  for (uint8_t r = 0; r < (options.dual ? 2 : 1); r++) {
+    ArduinoNative::schedule(end - SIM_STATS_BEFORE_END_US + r * 20000ULL, [r]() {
+      uint8_t request[SERIAL_RADIO_STATS_LEN] = { SERIAL_CMD_RADIO_STATS, r, 0 };
+      hostSend(request, sizeof(request));
+    });
+  }
+  ArduinoNative::schedule(end - SIM_STATS_BEFORE_END_US / 2, []() {
+    uint8_t request[SERIAL_LOOP_STATS_LEN] = { SERIAL_CMD_LOOP_STATS, 0 };
+    hostSend(request, sizeof(request));
+  });
+  ArduinoNative::schedule(end - SIM_STATS_BEFORE_END_US / 4, []() {
+    uint8_t request[SERIAL_AIRTIME_LEN] = { SERIAL_CMD_AIRTIME };
+    hostSend(request, sizeof(request));
+  });
+  uint64_t loops = 0;
+  while (ArduinoNative::now() < end) {
+    loop();
+    ArduinoNative::advance(SIM_LOOP_OVERHEAD_US);
+    loops++;
+  }
+  stats.mediumCarried(0, medium.carriedUs());
+  if (telemetryRadio) stats.mediumCarried(1, telemetryMedium.carriedUs());
+  stats.controllerDiscarded(radio.framesDiscarded + (telemetryRadio ? telemetryRadio->framesDiscarded : 0));
+
+  printf("\n=== %u hats, %.1f s, %u kbps, cue every %u ms, telemetry every %u ms, PER %.3f, seed %u ===\n",
+         options.hats, options.seconds, (unsigned)(radio.bitrate() / 1000), options.cueMs, options.telemetryMs, options.per, options.seed);
+  stats.report(stdout, options.seconds, loops, ArduinoNative::serialBytesOut());
+  uint16_t following = 0;
+  for (size_t i = 0; i < hats.size(); i++) following += RFM69::profileBitrate(hats[i]->profile()) == radio.bitrate();
+  printf("radio         controller at %u kbps, %u/%u hats with it\n", (unsigned)(radio.bitrate() / 1000), following, options.hats);
+  return 0;
+}
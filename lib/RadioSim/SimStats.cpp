@@ -0,0 +1,199 @@
+// **********************************************************************************
+// Simulation metrics, see SimStats.h
+// **********************************************************************************
+#include "SimStats.h"
+#include <ArduinoNative.h>
+#include <string.h>
+#include <algorithm>
+
+static const char* OUTCOME_NAMES[RADIO_OUTCOMES] = { "delivered", "not listening", "interrupted", "collision", "noise", "overrun" };
+
+SimStats::SimStats()
+  : _cuesInjected(0), _cueStart(0), _cueState(0), _cueDeliveries(0), _cueExpected(0), _cueFirstUs(0), _cueLastUs(0),
+    _telemetrySent(0), _telemetryDrained(0), _discarded(0), _cueRepairs(0), _cueRepairsWrapped(0),
+    _telemetryFrames(0), _telemetryRecords(0), _telemetryDropped(0), _fleetRequests(0), _fleetFrames(0), _fleetDumps(0), _fleetRecords(0), _fleetUntracked(0), _fleetStart(0),
+    _nodeAirtimeDone(false), _pollSlots(0), _pollAnswered(0),
+    _fleetPollNodes(0), _fleetPollAnswered(0), _fleetPollTimeouts(0) {
+  memset(_mediumCarriedUs, 0, sizeof(_mediumCarriedUs));
+  memset(_telemetryOutcomes, 0, sizeof(_telemetryOutcomes));
+  memset(_cueOutcomes, 0, sizeof(_cueOutcomes));
+}
+
+void SimStats::cueEnded() {
+  if (_cueSeen.size() >= 2) _cueSkew.push_back(_cueLastUs - _cueFirstUs);
+  _cueSeen.clear();
+}
+
+void SimStats::cueRepaired(uint64_t at) {
+  _cueRepairs++;
+  if (at >= 65536000ULL) _cueRepairsWrapped++;
+}
+
+void SimStats::cueInjected(uint8_t state, uint16_t hats) {
+  cueEnded();
+  _cuesInjected++;
+  _cueExpected += hats;
+  _cueStart = ArduinoNative::now();
+  _cueState = state;
+}
+
+void SimStats::telemetryFrame(uint8_t records, uint8_t dropped) {
+  _telemetryFrames++;
+  _telemetryRecords += records;
+  _telemetryDropped += dropped;
+}
+
+void SimStats::fleetRequested() {
+  _fleetRequests++;
+  _fleetStart = ArduinoNative::now();
+}
+
+void SimStats::fleetFrame(uint8_t records, bool last, bool untracked) {
+  _fleetFrames++;
+  _fleetRecords += records;
+  if (!last) return;
+  _fleetDumps++;
+  if (untracked) _fleetUntracked++;
+  _fleetLatency.push_back(ArduinoNative::now() - _fleetStart);
+}
+
+void SimStats::radioStatsFrame(const uint8_t* frame, uint8_t len) {
+  if (len < 3 || frame[1] >= SIM_STATS_RADIOS || frame[2] >= SERIAL_STATS_PARTS) return;
+  _radioStats[frame[1]][frame[2]].assign(frame, frame + len);
+}
+
+void SimStats::loopStatsFrame(const uint8_t* frame, uint8_t len) {
+  if (len != SERIAL_LOOP_SECTION_LEN || frame[1] >= SIM_LOOP_SECTIONS) return;
+  _loopStats[frame[1]].assign(frame, frame + len);
+}
+
+void SimStats::airtimeFrame(const uint8_t* frame, uint8_t len) {
+  if (len < 2) return;
+  if (_nodeAirtimeDone) {
+    _nodeAirtime.clear();
+    _nodeAirtimeDone = false;
+  }
+  for (uint8_t i = 2; i + SERIAL_AIRTIME_RECORD_LEN <= len; i += SERIAL_AIRTIME_RECORD_LEN) _nodeAirtime[frame[i]] = frame[i + 1];
+  if (frame[1] & SERIAL_FLEET_LAST) _nodeAirtimeDone = true;
+}
+
+void SimStats::pollFrame(const uint8_t* frame, uint8_t len) {
+  if (len != SERIAL_POLL_REPLY_LEN) return;
+  _pollSlots += frame[1];
+  _pollAnswered += frame[2];
+  _sweepTime.push_back(serialGetLong(&frame[3]));
+}
+
+void SimStats::fleetPollFrame(const uint8_t* frame, uint8_t len) {
+  if (len != SERIAL_FLEET_POLL_REPLY_LEN) return;
+  _fleetPollNodes += frame[1];
+  _fleetPollAnswered += frame[2];
+  _fleetPollTimeouts += serialGetShort(&frame[3]);
+  _fleetSweepTime.push_back(serialGetLong(&frame[5]));
+}
+
+void SimStats::cueDecoded(uint8_t hatId, uint8_t state) {
+  if (_cuesInjected == 0 || state != _cueState || _cueSeen.count(hatId)) return;
+  uint64_t now = ArduinoNative::now();
+  if (_cueSeen.empty()) _cueFirstUs = now;
+  _cueLastUs = now;
+  _cueSeen[hatId] = true;
+  _cueDeliveries++;
+  _cueLatency.push_back(now - _cueStart);
+}
+
+void SimStats::printLatency(FILE* out, const char* label, std::vector<uint32_t> samples) {
+  if (samples.empty()) {
+    fprintf(out, "%-13s no samples\n", label);
+    return;
+  }
+  std::sort(samples.begin(), samples.end());
+  double sum = 0;
+  for (size_t i = 0; i < samples.size(); i++) sum += samples[i];
+  size_t n = samples.size();
+  fprintf(out, "%-13s mean %.3f ms, p50 %.3f, p90 %.3f, p99 %.3f, max %.3f (n=%u)\n", label,
+          sum / n / 1000.0, samples[n / 2] / 1000.0, samples[n * 9 / 10] / 1000.0,
+          samples[n * 99 / 100] / 1000.0, samples[n - 1] / 1000.0, (unsigned)n);
+}
+
+void SimStats::report(FILE* out, double seconds, uint64_t loops, uint64_t serialBytes) {
+  fprintf(out, "cues          injected %u, decoded %u/%u hat-cues (%.2f%%)\n", _cuesInjected, _cueDeliveries, _cueExpected,
+          _cueExpected ? 100.0 * _cueDeliveries / _cueExpected : 0.0);
+  printLatency(out, "cue latency", _cueLatency);
+  cueEnded();
+  printLatency(out, "cue skew", _cueSkew); // first to last hat acting on each cue
+  fprintf(out, "cue frames   ");
+  for (uint8_t i = 0; i < RADIO_OUTCOMES; i++) fprintf(out, " %s %u%s", OUTCOME_NAMES[i], _cueOutcomes[i], i + 1 < RADIO_OUTCOMES ? "," : "\n");
+  if (_cueRepairs) fprintf(out, "cue repairs   %u sent, %u after millis() passed 65536 ms\n", _cueRepairs, _cueRepairsWrapped);
+  fprintf(out, "telemetry     sent %u, drained by driver %u (%.2f%%), discarded in FIFO %u\n", _telemetrySent, _telemetryDrained,
+          _telemetrySent ? 100.0 * _telemetryDrained / _telemetrySent : 0.0, _discarded);
+  fprintf(out, "telemetry air");
+  for (uint8_t i = 0; i < RADIO_OUTCOMES; i++) fprintf(out, " %s %u%s", OUTCOME_NAMES[i], _telemetryOutcomes[i], i + 1 < RADIO_OUTCOMES ? "," : "\n");
+  if (_telemetryFrames) {
+    fprintf(out, "telemetry out %u records in %u frames, %u dropped by the serial link\n", _telemetryRecords, _telemetryFrames,
+            _telemetryDropped);
+  }
+  if (_fleetRequests) {
+    fprintf(out, "fleet dumps   requested %u, completed %u, %u records in %u frames\n", _fleetRequests, _fleetDumps,
+            _fleetRecords, _fleetFrames);
+    if (_fleetUntracked) fprintf(out, "fleet dumps   %u flagged nodes beyond the table\n", _fleetUntracked);
+    printLatency(out, "fleet latency", _fleetLatency);
+  }
+  if (!_sweepTime.empty()) {
+    fprintf(out, "poll sweeps   %u, answered %u/%u slots (%.2f%%)\n", (unsigned)_sweepTime.size(), _pollAnswered, _pollSlots,
+            _pollSlots ? 100.0 * _pollAnswered / _pollSlots : 0.0);
+    printLatency(out, "sweep time", _sweepTime);
+  }
+  if (!_fleetSweepTime.empty()) {
+    fprintf(out, "fleet polls   %u, answered %u/%u nodes (%.2f%%), %u timeouts\n", (unsigned)_fleetSweepTime.size(),
+            _fleetPollAnswered, _fleetPollNodes, _fleetPollNodes ? 100.0 * _fleetPollAnswered / _fleetPollNodes : 0.0,
+            _fleetPollTimeouts);
+    printLatency(out, "fleet sweep", _fleetSweepTime);
+  }
+  for (uint8_t r = 0; r < SIM_STATS_RADIOS; r++) {
+    const std::vector<uint8_t>& counters = _radioStats[r][SERIAL_STATS_COUNTERS];
+    const std::vector<uint8_t>& histograms = _radioStats[r][SERIAL_STATS_HISTOGRAMS];
+    if (counters.size() != SERIAL_STATS_COUNTERS_LEN || histograms.size() != SERIAL_STATS_HISTOGRAMS_LEN) continue;
+    const uint8_t* c = &counters[3];
+    fprintf(out, "radio %u       sent %u, received %u, filtered %u, bad %u, rx dropped %u, rx restarts %u, csma timeouts %u,"
+                 " tx timeouts %u, retry failures %u, csma busy %u, power level %u\n", r, serialGetLong(&c[1]), serialGetLong(&c[5]),
+            serialGetShort(&c[9]), serialGetShort(&c[11]), serialGetShort(&c[13]), serialGetShort(&c[15]),
+            serialGetShort(&c[17]), serialGetShort(&c[19]), serialGetShort(&c[21]), serialGetShort(&c[23]), c[0]);
+    const uint8_t* h = &histograms[3];
+    const char* labels[] = { "  csma wait", "  ack rtt" };
+    for (uint8_t k = 0; k < 2; k++, h += 2 * SERIAL_STATS_BUCKETS) {
+      fprintf(out, "%-13s", labels[k]);
+      for (uint8_t i = 0; i < SERIAL_STATS_BUCKETS; i++)
+        fprintf(out, " %s%ums%s %u%s", i == 0 ? "<" : "", i == 0 ? 1 : 1U << (i - 1), i + 1 == SERIAL_STATS_BUCKETS ? "+" : "",
+                serialGetShort(&h[2 * i]), i + 1 < SERIAL_STATS_BUCKETS ? "," : "\n");
+    }
+    fprintf(out, "  retries    ");
+    for (uint8_t i = 0; i < SERIAL_STATS_RETRIES; i++)
+      fprintf(out, " %u%s %u%s", i, i + 1 == SERIAL_STATS_RETRIES ? "+" : "", serialGetShort(&h[2 * i]), i + 1 < SERIAL_STATS_RETRIES ? "," : "\n");
+    // the driver only counts what it sent or decoded; the medium also carried collisions and other nodes' misses
+    double txMs = serialGetLong(&c[25]) / 1000.0, rxMs = serialGetLong(&c[29]) / 1000.0;
+    fprintf(out, "  airtime     tx %.1f ms, rx %.1f ms (%.1f%% of the %.1f ms the channel carried), last second tx %.2f%% rx %.2f%%\n",
+            txMs, rxMs, _mediumCarriedUs[r] ? 100.0 * (txMs + rxMs) / (_mediumCarriedUs[r] / 1000.0) : 0.0,
+            _mediumCarriedUs[r] / 1000.0, serialGetLong(&c[33]) / 10000.0, serialGetLong(&c[37]) / 10000.0);
+  }
+  const char* sections[SIM_LOOP_SECTIONS] = { "loop()", "receive", "serial", "payload", "OTA check" };
+  for (uint8_t i = 0; i < SIM_LOOP_SECTIONS; i++) {
+    if (_loopStats[i].empty()) continue;
+    const uint8_t* l = &_loopStats[i][2];
+    fprintf(out, "%-13s %s n %u, p99 %u us, max %u us\n", i == 0 ? "loop profile" : "", sections[i], serialGetLong(&l[0]),
+            serialGetLong(&l[8]), serialGetLong(&l[4]));
+  }
+  if (_nodeAirtimeDone) {
+    uint32_t sum = 0;
+    uint8_t maxNode = 0, maxUnits = 0;
+    for (std::map<uint8_t, uint8_t>::const_iterator i = _nodeAirtime.begin(); i != _nodeAirtime.end(); ++i) {
+      sum += i->second;
+      if (i->second > maxUnits) { maxUnits = i->second; maxNode = i->first; }
+    }
+    size_t n = _nodeAirtime.size();
+    fprintf(out, "node airtime  %u nodes heard in the last second, mean %.2f ms, max %.2f ms (node %u), total %.1f%% of a channel\n",
+            (unsigned)n, n ? sum * 0.256 / n : 0.0, maxUnits * 0.256, maxNode, sum * 0.0256);
+  }
+  fprintf(out, "controller    %llu loop() iterations (%.1f us avg), %llu serial bytes out\n", (unsigned long long)loops,
+          loops ? seconds * 1e6 / loops : 0.0, (unsigned long long)serialBytes);
+}
@@ -0,0 +1,91 @@
+// **********************************************************************************
+// Metrics collected by the native simulation and printed at the end of a run
+// **********************************************************************************
+#ifndef SimStats_h
+#define SimStats_h
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+#include <SerialLink.h>
+#include "RadioMedium.h"
+
+#define SIM_STATS_RADIOS 2 // SERIAL_CMD_RADIO_STATS radio 0 and 1
+#define SIM_LOOP_SECTIONS 5 // PROFILE_SECTIONS
+
+class SimStats {
+  public:
+    SimStats();
+    void cueEnded(); // the current cue's acts are all in, called by cueInjected() and report()
+
+    void cueInjected(uint8_t state, uint16_t hats); // the host just sent a cue for this many hats to the controller's serial port
+    void cueDecoded(uint8_t hatId, uint8_t state);
+    void telemetrySent() { _telemetrySent++; }
+    void telemetryDrained() { _telemetryDrained++; }
+    void telemetryOutcome(RadioOutcome outcome) { _telemetryOutcomes[outcome]++; }
+    void cueFrameOutcome(RadioOutcome outcome) { _cueOutcomes[outcome]++; }
+    void cueRepaired(uint64_t at); // the controller re-sent a numbered cue to one hat, at = sim time in us
+    void controllerDiscarded(uint32_t frames) { _discarded = frames; }
+    void telemetryFrame(uint8_t records, uint8_t dropped); // one SERIAL_RSP_TELEMETRY frame arrived at the host
+    void fleetRequested(); // the host just asked for a SERIAL_CMD_FLEET_DUMP
+    void fleetFrame(uint8_t records, bool last, bool untracked); // one SERIAL_RSP_FLEET frame arrived at the host
+    void radioStatsFrame(const uint8_t* frame, uint8_t len); // one SERIAL_RSP_RADIO_STATS frame, type included
+    void loopStatsFrame(const uint8_t* frame, uint8_t len);  // one SERIAL_RSP_LOOP_STATS frame, type included
+    void airtimeFrame(const uint8_t* frame, uint8_t len);    // one SERIAL_RSP_AIRTIME frame, type included
+    void pollFrame(const uint8_t* frame, uint8_t len);       // one SERIAL_RSP_POLL frame, type included
+    void fleetPollFrame(const uint8_t* frame, uint8_t len);  // one SERIAL_RSP_FLEET_POLL frame, type included
+    void mediumCarried(uint8_t radio, uint64_t us) { _mediumCarriedUs[radio] = us; } // what that radio's channel carried
+
+    void report(FILE* out, double seconds, uint64_t loops, uint64_t serialBytes);
+
+    static void printLatency(FILE* out, const char* label, std::vector<uint32_t> samples);
+
+  private:
+    uint32_t _cuesInjected;
+    uint64_t _cueStart;
+    uint8_t _cueState;
+    std::map<uint8_t, bool> _cueSeen; // hats that decoded the current cue
+    uint32_t _cueDeliveries;
+    uint32_t _cueExpected;
+    std::vector<uint32_t> _cueLatency;
+    uint64_t _cueFirstUs; // first and last hat to act on the current cue
+    uint64_t _cueLastUs;
+    std::vector<uint32_t> _cueSkew;
+
+    uint32_t _telemetrySent;
+    uint32_t _telemetryDrained;
+    uint32_t _discarded;
+    uint32_t _telemetryOutcomes[RADIO_OUTCOMES];
+    uint32_t _cueOutcomes[RADIO_OUTCOMES];
+    uint32_t _cueRepairs;
+    uint32_t _cueRepairsWrapped; // after the 16 bit millis() CueHistory ages cues by wrapped
+
+    uint32_t _telemetryFrames;
+    uint32_t _telemetryRecords;
+    uint32_t _telemetryDropped;
+
+    uint32_t _fleetRequests;
+    uint32_t _fleetFrames;
+    uint32_t _fleetDumps;
+    uint32_t _fleetRecords;
+    uint32_t _fleetUntracked; // dumps flagged SERIAL_FLEET_UNTRACKED
+    uint64_t _fleetStart;
+    std::vector<uint32_t> _fleetLatency; // request to the frame with SERIAL_FLEET_LAST
+
+    std::vector<uint8_t> _radioStats[SIM_STATS_RADIOS][SERIAL_STATS_PARTS]; // latest frame of each part
+    std::vector<uint8_t> _loopStats[SIM_LOOP_SECTIONS];
+    uint64_t _mediumCarriedUs[SIM_STATS_RADIOS];
+    std::map<uint8_t, uint8_t> _nodeAirtime; // SERIAL_RSP_AIRTIME records of the current dump
+    bool _nodeAirtimeDone;                   // that dump's last frame arrived
+
+    uint32_t _pollSlots;    // over all SERIAL_RSP_POLL sweeps
+    uint32_t _pollAnswered;
+    std::vector<uint32_t> _sweepTime;
+
+    uint32_t _fleetPollNodes; // over all SERIAL_RSP_FLEET_POLL sweeps
+    uint32_t _fleetPollAnswered;
+    uint32_t _fleetPollTimeouts;
+    std::vector<uint32_t> _fleetSweepTime;
+};
+
+#endif
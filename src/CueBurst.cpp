@@ -0,0 +1,61 @@
+// **********************************************************************************
+// Redundant cue bursts, see CueBurst.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "CueBurst.h"
+
+// offset of copiesLeft in an encoded cue: header, state, flags, then seq and group when flagged
+static uint8_t burstFieldsAt(const uint8_t* frame) {
+  return 3 + ((frame[2] & ANTLER_CUE_SEQ) != 0) + ((frame[2] & ANTLER_CUE_GROUP) != 0);
+}
+
+bool CueBurst::configure(uint8_t newCopies, uint8_t newSpacingMs) {
+  if (newCopies == 0 || newCopies > BURST_MAX_COPIES) return false;
+  if ((uint16_t)(newCopies - 1) * newSpacingMs + 2 * BURST_JITTER_MS > 255) return false;
+  copies = newCopies;
+  spacingMs = newSpacingMs;
+  return true;
+}
+
+bool CueBurst::start(ToAntlersPayload& cue, uint8_t node) {
+  for (uint8_t i = 0; i < BURST_SLOTS; i++) {
+    Slot& slot = _slots[i];
+    if (slot.left) continue;
+    slot.node = node;
+    slot.left = copies;
+    slot.spacingMs = spacingMs;
+    slot.nextMs = millis();
+    // the last copy may be BURST_JITTER_MS late, leave as long again for it to go out
+    uint32_t fireIn = (uint32_t)(copies - 1) * spacingMs + 2 * BURST_JITTER_MS;
+    slot.fireMs = slot.nextMs + fireIn;
+    cue.atMicros = micros() + fireIn * 1000;
+    cue.atUse = true;
+    ToAntlersPayload first = cue;
+    first.copiesLeft = copies; // any non zero value, so the burst fields are in the frame
+    slot.len = antlerEncodeCue(first, slot.frame);
+    return true;
+  }
+  return false;
+}
+
+uint8_t CueBurst::due(uint8_t* frame, uint8_t& node) {
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < BURST_SLOTS; i++) {
+    Slot& slot = _slots[i];
+    if (!slot.left || (int32_t)(now - slot.nextMs) < 0) continue;
+
+    slot.left--;
+    uint8_t at = burstFieldsAt(slot.frame);
+    int32_t fireIn = slot.fireMs - now;
+    slot.frame[at] = slot.left;
+    slot.frame[at + 1] = fireIn < 0 ? 0 : fireIn;
+    if (slot.left) // nominal time of the next copy counts back from the fire time, so jitter never adds up
+      slot.nextMs = slot.fireMs - 2 * BURST_JITTER_MS - (uint32_t)(slot.left - 1) * slot.spacingMs + random(-BURST_JITTER_MS, BURST_JITTER_MS + 1);
+    node = slot.node;
+    memcpy(frame, slot.frame, slot.len);
+    return slot.len;
+  }
+  return 0;
+}
@@ -0,0 +1,36 @@
+// **********************************************************************************
+// Broadcast cue history and repair, see CueHistory.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "CueHistory.h"
+
+void CueHistory::add(uint8_t seq, const uint8_t* frame, uint8_t len) {
+  if (_count == CUE_HISTORY_LEN) {
+    memmove(&_entries[0], &_entries[1], sizeof(Entry) * (CUE_HISTORY_LEN - 1));
+    _count--;
+  }
+  Entry& entry = _entries[_count++];
+  entry.seq = seq;
+  entry.len = len;
+  entry.sentMs = millis();
+  memcpy(entry.frame, frame, len);
+}
+
+bool CueHistory::missing(const ToControllersPayload& telemetry, uint8_t seq) const {
+  if (!telemetry.cueSeqUse || antlerSeqNewer(seq, telemetry.cueSeq)) return true; // never heard, or sent after the newest it heard
+  uint8_t behind = telemetry.cueSeq - seq;
+  return behind >= 1 && behind <= 8 && (telemetry.cueMissed & (1 << (behind - 1)));
+}
+
+uint8_t CueHistory::nextMissing(const ToControllersPayload& telemetry, uint8_t from, const uint8_t*& frame, uint8_t& len) {
+  for (uint8_t i = from; i < _count; i++) {
+    if ((uint16_t)((uint16_t)millis() - _entries[i].sentMs) < CUE_REPAIR_HOLDOFF_MS) break; // the rest are newer still, cast back: the difference is an int
+    if (!missing(telemetry, _entries[i].seq)) continue;
+    frame = _entries[i].frame;
+    len = _entries[i].len;
+    return i + 1;
+  }
+  return 0;
+}
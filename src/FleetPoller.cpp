@@ -0,0 +1,111 @@
+// **********************************************************************************
+// Fleet polling, see FleetPoller.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "FleetPoller.h"
+
+FleetPoller::FleetPoller() : _firstNode(0), _nodes(0), _window(1), _timeoutMs(0), _periodMs(0), _repeat(false),
+                             _nextMs(0), _sweeping(false), _finished(false), _pass(0), _cursor(0), _startMicros(0),
+                             _sweepUs(0), _answered(0), _timeouts(0), _outCount(0) {}
+
+void FleetPoller::setBit(uint8_t* bits, uint8_t n, bool on) {
+  if (on) bits[n >> 3] |= 1 << (n & 7);
+  else bits[n >> 3] &= ~(1 << (n & 7));
+}
+
+bool FleetPoller::configure(uint8_t firstNode, uint8_t nodes, uint8_t window, uint8_t timeoutMs, uint16_t periodMs) {
+  if (window == 0 || window > POLLER_WINDOW_MAX || timeoutMs < POLLER_MIN_TIMEOUT_MS ||
+      (periodMs != 0 && periodMs < POLLER_MIN_PERIOD_MS) || firstNode + nodes > 256 ||
+      (firstNode == 0 && nodes != 0)) return false; // node 0 is the broadcast address, every hat would answer
+  _firstNode = firstNode;
+  _nodes = nodes;
+  _window = window;
+  _timeoutMs = timeoutMs;
+  _periodMs = periodMs;
+  _repeat = nodes != 0;
+  _nextMs = millis();
+  _sweeping = false; // a sweep in progress is dropped, late answers to it are ignored
+  _outCount = 0;
+  return true;
+}
+
+void FleetPoller::drop(uint8_t i) {
+  _out[i] = _out[--_outCount];
+}
+
+void FleetPoller::tick() {
+  if (!_sweeping) {
+    if (!_repeat || (int32_t)(millis() - _nextMs) < 0) return;
+    _nextMs += _periodMs;
+    if ((int32_t)(millis() - _nextMs) > 0) _nextMs = millis(); // the last sweep overran the period
+    _repeat = _periodMs != 0;
+    _sweeping = true;
+    _pass = 0;
+    _cursor = 0;
+    _startMicros = micros();
+    _answered = 0;
+    _timeouts = 0;
+    memset(_done, 0, sizeof(_done));
+    memset(_retry, 0, sizeof(_retry));
+    return;
+  }
+
+  for (uint8_t i = 0; i < _outCount; ) {
+    if (millis() - _out[i].sentMs < _timeoutMs) { i++; continue; }
+    setBit(_retry, _out[i].node, true);
+    _timeouts++;
+    drop(i);
+  }
+  if (_cursor < _nodes || _outCount) return;
+
+  // the pass is over: ask the hats that timed out again, or end the sweep
+  bool again = false;
+  for (uint16_t n = 0; n < _nodes && !again; n++) again = bit(_retry, _firstNode + n);
+  if (again && ++_pass < POLLER_PASSES) {
+    _cursor = 0;
+    return;
+  }
+  _sweeping = false;
+  _finished = true;
+  _sweepUs = micros() - _startMicros;
+}
+
+bool FleetPoller::next(uint8_t& node) {
+  if (!_sweeping || _outCount >= _window) return false;
+  while (_cursor < _nodes) {
+    uint8_t n = _firstNode + _cursor++;
+    if (bit(_done, n) || (_pass && !bit(_retry, n))) continue;
+    setBit(_retry, n, false);
+    _out[_outCount].node = n;
+    _out[_outCount].sentMs = millis();
+    _outCount++;
+    node = n;
+    return true;
+  }
+  return false;
+}
+
+void FleetPoller::heard(uint8_t nodeId) {
+  if (!_sweeping || (uint8_t)(nodeId - _firstNode) >= _nodes || bit(_done, nodeId)) return;
+  setBit(_done, nodeId, true);
+  setBit(_retry, nodeId, false);
+  _answered++;
+  for (uint8_t i = 0; i < _outCount; i++) {
+    if (_out[i].node == nodeId) {
+      drop(i);
+      break;
+    }
+  }
+}
+
+bool FleetPoller::finished(uint8_t& nodes, uint8_t& answered, uint16_t& timeouts, uint32_t& sweepUs) {
+  if (!_finished) return false;
+  _finished = false;
+  nodes = _nodes;
+  answered = _answered;
+  timeouts = _timeouts;
+  sweepUs = _sweepUs;
+  return true;
+}
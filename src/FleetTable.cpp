@@ -0,0 +1,66 @@
+// **********************************************************************************
+// Fleet telemetry table, see FleetTable.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "FleetTable.h"
+
+FleetTable::FleetTable() : _agedMs(0), _dumpNext(FLEET_MAX_NODES), _dumpChanged(false), _untracked(false) {
+  memset(_vcc, 0, sizeof(_vcc));
+  memset(_changed, 0, sizeof(_changed));
+}
+
+bool FleetTable::update(const ToControllersPayload& payload, int16_t rssi) {
+  uint8_t id = payload.nodeId;
+  if (id >= FLEET_MAX_NODES) {
+    _untracked = true;
+    return false;
+  }
+
+  int16_t vcc = payload.vcc * 50 + 0.5f; // 20mV steps
+  _state[id] = payload.state;
+  _link[id] = (payload.antlerState ? 0x80 : 0) | (rssi < -127 ? 127 : rssi > 0 ? 0 : -rssi);
+  _vcc[id] = vcc < 1 ? 1 : vcc > 255 ? 255 : vcc; // a hat that reports 0V still counts as heard
+  _temperature[id] = constrain(payload.temperature, -128, 127);
+  _seen[id] = (_seen[id] + 0x10) & 0xF0;             // count the packet, age 0
+  _changed[id >> 3] |= 1 << (id & 7);
+  return true;
+}
+
+void FleetTable::tick() {
+  if (millis() - _agedMs < FLEET_AGE_PERIOD_MS) return;
+  _agedMs += FLEET_AGE_PERIOD_MS;
+  for (uint16_t id = 0; id < FLEET_MAX_NODES; id++) {
+    if ((_seen[id] & 0x0F) < FLEET_AGE_MAX) _seen[id]++;
+  }
+}
+
+void FleetTable::startDump(bool changedOnly) {
+  _dumpNext = 0;
+  _dumpChanged = changedOnly;
+}
+
+bool FleetTable::nextRecords(uint8_t* out, uint8_t max, uint8_t& count) {
+  count = 0;
+  while (_dumpNext < FLEET_MAX_NODES && count < max) {
+    uint8_t id = _dumpNext++;
+    if (!known(id) || (_dumpChanged && !changed(id))) continue;
+    out[0] = id;
+    out[1] = _state[id];
+    out[2] = _link[id];
+    out[3] = _vcc[id];
+    out[4] = _temperature[id];
+    out[5] = _seen[id];
+    out += FLEET_RECORD_LEN;
+    count++;
+    _changed[id >> 3] &= ~(1 << (id & 7));
+  }
+  return dumping();
+}
+
+bool FleetTable::untracked() {
+  bool heard = _untracked;
+  _untracked = false;
+  return heard;
+}
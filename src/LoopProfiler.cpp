@@ -0,0 +1,42 @@
+// **********************************************************************************
+// loop() latency histograms, see LoopProfiler.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "LoopProfiler.h"
+
+LoopProfiler::LoopProfiler() {
+  for (uint8_t i = 0; i < PROFILE_SECTIONS; i++) reset(i);
+}
+
+uint8_t LoopProfiler::bucketOf(uint32_t us) {
+  uint8_t bucket = 0;
+  for (us >>= 2; us && bucket < PROFILE_BUCKETS - 1; us >>= 1) bucket++;
+  return bucket;
+}
+
+void LoopProfiler::record(uint8_t section, uint32_t us) {
+  uint16_t& bucket = _buckets[section][bucketOf(us)];
+  if (bucket != 0xFFFF) bucket++;
+  _count[section]++;
+  if (us > _max[section]) _max[section] = us;
+}
+
+void LoopProfiler::reset(uint8_t section) {
+  memset(_buckets[section], 0, sizeof(_buckets[section]));
+  _count[section] = 0;
+  _max[section] = 0;
+}
+
+uint32_t LoopProfiler::p99Us(uint8_t section) const {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < PROFILE_BUCKETS; i++) total += _buckets[section][i];
+  uint32_t below = total - total / 100; // samples at or under the 99th percentile
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < PROFILE_BUCKETS - 1; i++) {
+    seen += _buckets[section][i];
+    if (seen >= below) return min(4UL << i, (unsigned long)_max[section]);
+  }
+  return _max[section];
+}
@@ -0,0 +1,42 @@
+// **********************************************************************************
+// Per node airtime, see NodeAirtime.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "NodeAirtime.h"
+
+NodeAirtime::NodeAirtime() : _periodStart(0), _dumpNext(FLEET_MAX_NODES) {
+  memset(_current, 0, sizeof(_current));
+  memset(_last, 0, sizeof(_last));
+}
+
+void NodeAirtime::add(uint16_t nodeId, uint32_t airtimeUs) {
+  if (nodeId >= FLEET_MAX_NODES) return;
+  uint32_t units = _current[nodeId] + (airtimeUs + NODE_AIRTIME_UNIT_US / 2) / NODE_AIRTIME_UNIT_US;
+  _current[nodeId] = units > 255 ? 255 : units;
+}
+
+void NodeAirtime::tick() {
+  uint32_t now = millis();
+  uint32_t elapsed = now - _periodStart;
+  if (elapsed < NODE_AIRTIME_PERIOD_MS) return;
+  // a loop() stalled past a whole period leaves nothing to say about the last one
+  if (elapsed < 2 * NODE_AIRTIME_PERIOD_MS) memcpy(_last, _current, sizeof(_last));
+  else memset(_last, 0, sizeof(_last));
+  memset(_current, 0, sizeof(_current));
+  _periodStart = now - elapsed % NODE_AIRTIME_PERIOD_MS;
+}
+
+bool NodeAirtime::nextRecords(uint8_t* out, uint8_t max, uint8_t& count) {
+  count = 0;
+  while (_dumpNext < FLEET_MAX_NODES && count < max) {
+    uint8_t id = _dumpNext++;
+    if (_last[id] == 0) continue;
+    out[0] = id;
+    out[1] = _last[id];
+    out += NODE_AIRTIME_RECORD_LEN;
+    count++;
+  }
+  return dumping();
+}
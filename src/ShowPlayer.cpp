@@ -0,0 +1,77 @@
+// **********************************************************************************
+// Cue list playback from SPI flash, see ShowPlayer.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "ShowPlayer.h"
+#include <SerialLink.h>
+
+static const char SHOW_MAGIC[4] = { 'S', 'H', 'O', 'W' };
+
+void ShowPlayer::erase() {
+  _playing = false;
+  _count = 0;
+  _flash.blockErase64K(SHOW_FLASH_ADDR);
+}
+
+bool ShowPlayer::store(uint16_t index, const uint8_t* record) {
+  if (index >= SHOW_MAX_CUES) return false;
+  _flash.writeBytes(recordAddr(index), record, SHOW_RECORD_LEN);
+  return true;
+}
+
+bool ShowPlayer::commit(uint16_t count) {
+  if (count == 0 || count > SHOW_MAX_CUES) return false;
+  uint8_t header[6];
+  memcpy(header, SHOW_MAGIC, 4);
+  serialPutShort(&header[4], count);
+  _flash.writeBytes(SHOW_FLASH_ADDR, header, sizeof(header));
+  _count = count;
+  return true;
+}
+
+uint16_t ShowPlayer::load() {
+  uint8_t header[6];
+  _flash.readBytes(SHOW_FLASH_ADDR, header, sizeof(header));
+  uint16_t count = serialGetShort(&header[4]);
+  _count = memcmp(header, SHOW_MAGIC, 4) == 0 && count <= SHOW_MAX_CUES ? count : 0;
+  return _count;
+}
+
+bool ShowPlayer::start(uint32_t fromMs) {
+  _playing = false;
+  if (load() == 0) return false;
+
+  // binary search for the first cue at or after fromMs
+  uint16_t lo = 0, hi = _count;
+  while (lo < hi) {
+    uint16_t mid = lo + (hi - lo) / 2;
+    uint8_t atMs[4];
+    _flash.readBytes(recordAddr(mid), atMs, sizeof(atMs));
+    if (serialGetLong(atMs) < fromMs) lo = mid + 1;
+    else hi = mid;
+  }
+
+  _position = lo;
+  _fetched = false;
+  _startMs = millis() - fromMs;
+  _playing = true;
+  return true;
+}
+
+const uint8_t* ShowPlayer::due() {
+  if (!_playing) return NULL;
+  if (!_fetched) {
+    if (_position >= _count) {
+      _playing = false;
+      return NULL;
+    }
+    _flash.readBytes(recordAddr(_position), _next, SHOW_RECORD_LEN);
+    _fetched = true;
+  }
+  if (millis() - _startMs < serialGetLong(_next)) return NULL;
+  _position++;
+  _fetched = false; // _next stays valid until the following call
+  return _next;
+}
@@ -0,0 +1,46 @@
+// **********************************************************************************
+// Time sync beacons, see SyncBeacon.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "SyncBeacon.h"
+
+uint8_t SyncBeacon::due(uint8_t* frame) {
+  uint32_t now = millis();
+  if ((int32_t)(now - _nextMs) < 0) return 0;
+  _nextMs = now + (_switchUse ? SYNC_INTERVAL_MS / SYNC_SWITCH_SPEEDUP : SYNC_INTERVAL_MS);
+
+  AntlerSyncPayload sync;
+  sync.seq = _seq;
+  sync.prevUse = _sentUse && _sentSeq == (uint8_t)(_seq - 1);
+  sync.prevMicros = _sentMicros;
+  sync.switchUse = _switchUse;
+  sync.profile = _switchProfile;
+  sync.switchMicros = _switchMicros;
+  sync.telemetryUse = _telemetryUse;
+  _sentUse = false;
+  _seq++;
+  return antlerEncodeSync(sync, frame);
+}
+
+void SyncBeacon::sent(uint32_t txMicros) {
+  _sentMicros = txMicros;
+  _sentSeq = _seq - 1;
+  _sentUse = true;
+}
+
+bool SyncBeacon::announceSwitch(uint8_t profile, uint16_t afterMs) {
+  if (profile >= ANTLER_PROFILES || afterMs < SYNC_SWITCH_MIN_MS) return false;
+  _switchProfile = profile;
+  _switchMicros = micros() + afterMs * 1000UL;
+  _switchUse = true;
+  _nextMs = millis(); // start announcing right away
+  return true;
+}
+
+bool SyncBeacon::switchDue(uint8_t& profile) const {
+  if (!_switchUse || (int32_t)(micros() - _switchMicros) < 0) return false;
+  profile = _switchProfile;
+  return true;
+}
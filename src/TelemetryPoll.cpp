@@ -0,0 +1,64 @@
+// **********************************************************************************
+// Telemetry sweeps, see TelemetryPoll.h
+// **********************************************************************************
+// Copyright 2021 Radio City Music Hall
+// Contact: Michael Sauder, michael.sauder@msg.com
+// **********************************************************************************
+#include "TelemetryPoll.h"
+
+TelemetryPoll::TelemetryPoll() : _periodMs(0), _repeat(false), _nextMs(0), _state(POLL_IDLE),
+                                 _dueMicros(0), _endMicros(0), _answered(0) {
+  _poll.firstNode = 0;
+  _poll.slots = 0;
+  _poll.slotUs = 0;
+  _poll.assigned = false;
+}
+
+bool TelemetryPoll::configure(uint8_t firstNode, uint8_t slots, bool assigned, uint16_t periodMs) {
+  if (periodMs != 0 && periodMs < POLL_MIN_PERIOD_MS) return false;
+  _poll.firstNode = firstNode;
+  _poll.slots = slots;
+  _poll.assigned = assigned;
+  _periodMs = periodMs;
+  _repeat = slots != 0;
+  _nextMs = millis(); // the first sweep right away, or after the one in progress
+  return true;
+}
+
+uint8_t TelemetryPoll::due(uint8_t* frame, uint16_t slotUs) {
+  if (!_repeat || _state != POLL_IDLE || (int32_t)(millis() - _nextMs) < 0) return 0;
+  _nextMs += _periodMs;
+  if ((int32_t)(millis() - _nextMs) > 0) _nextMs = millis(); // the last sweep overran the period
+  _repeat = _periodMs != 0;
+  _poll.slotUs = slotUs;
+  _state = POLL_QUEUED;
+  _dueMicros = micros();
+  _answered = 0;
+  memset(_heard, 0, sizeof(_heard));
+  return antlerEncodePoll(_poll, frame);
+}
+
+void TelemetryPoll::sent(uint32_t txMicros) {
+  if (_state != POLL_QUEUED) return;
+  _endMicros = txMicros + ANTLER_POLL_START_US + (uint32_t)_poll.slots * _poll.slotUs;
+  _state = POLL_SLOTS;
+}
+
+void TelemetryPoll::lost() {
+  _state = POLL_IDLE;
+}
+
+void TelemetryPoll::heard(uint8_t nodeId) {
+  if (_state != POLL_SLOTS || (_heard[nodeId >> 3] & (1 << (nodeId & 7)))) return;
+  _heard[nodeId >> 3] |= 1 << (nodeId & 7);
+  _answered++;
+}
+
+bool TelemetryPoll::finished(uint8_t& slots, uint8_t& answered, uint32_t& sweepUs) {
+  if (_state != POLL_SLOTS || (int32_t)(micros() - _endMicros) < 0) return false;
+  _state = POLL_IDLE;
+  slots = _poll.slots;
+  answered = _answered;
+  sweepUs = _endMicros - _dueMicros;
+  return true;
+}
@@ -13,6 +13,17 @@
 #include <RFM69_ATC.h>     //get it here: https://github.com/lowpowerlab/RFM69
 #include <RFM69_OTA.h>     //get it here: https://github.com/lowpowerlab/RFM69
 #include <SPIFlash.h>      //get it here: https://github.com/lowpowerlab/spiflash
+#include <AntlerProtocol.h> // payload structs shared with the antler hats
+#include <SerialLink.h>     // framed binary commands from the show host
+#include "ShowPlayer.h"     // cue list stored in flash
+#include "FleetTable.h"     // last telemetry from every hat
+#include "CueHistory.h"     // broadcast cues kept for repair
+#include "CueBurst.h"       // redundant copies of show critical cues
+#include "SyncBeacon.h"     // network time for hats to act on cues together
+#include "LoopProfiler.h"   // loop() latency histograms
+#include "NodeAirtime.h"    // channel time each hat takes
+#include "TelemetryPoll.h"  // collision free telemetry sweeps
+#include "FleetPoller.h"    // status requests to every hat, several at a time
 //#include <EEPROMex.h>      //get it here: http://playground.arduino.cc/Code/EEPROMex
 
 #define NODEID       3  // node ID used for this unit
@@ -26,6 +37,9 @@
 #define FREQUENCY_EXACT 915000000
 #define ENCRYPTKEY  "rcmhprodrcmhprod" //16-bytes or ""/0/null for no encryption
 #define IS_RFM69HW_HCW  //uncomment only for RFM69HW/HCW! Leave out if you have RFM69W/CW!
+//#define DUAL_RADIO      //uncomment to receive telemetry on a second RFM69, so cues never wait behind hat chatter
+#define TELEMETRY_CS    7 //second radio's slave select
+#define TELEMETRY_IRQ   3 //and its DIO0, must be INT1 as the cue radio has INT0
 //*****************************************************************************************************************************
 #define ENABLE_ATC    //comment out this line to disable AUTO TRANSMISSION CONTROL
 #define ATC_RSSI      -80
@@ -38,21 +52,86 @@
 //*****************************************************************************************************************************
 
 #define ANTLER_PIN   6 //PWM pin for controlling antler LEDs
+#define FLEET_FRAME_RECORDS 6 // fleet records per reply frame, keeps a frame inside the 64 byte serial TX buffer
+#define TELEMETRY_BATCH_RECORDS 4 // packets batched into one SERIAL_RSP_TELEMETRY frame
+#define FLEET_FRAME_MAX (2 + FLEET_FRAME_RECORDS * FLEET_RECORD_LEN) // type + body
+#define AIRTIME_FRAME_RECORDS 18 // SERIAL_RSP_AIRTIME records per frame, the same size as a fleet frame
+#define AIRTIME_FRAME_MAX (2 + AIRTIME_FRAME_RECORDS * NODE_AIRTIME_RECORD_LEN)
+#define REPLY_FRAME_MAX SERIAL_LOOP_SECTION_LEN // largest reply frame
+#define STAMPED_FRAME_MAX (ANTLER_SYNC_MAX_LEN > ANTLER_POLL_LEN ? ANTLER_SYNC_MAX_LEN : ANTLER_POLL_LEN)
+#define ARM_NONE     0xFF // sendAntlerPayload() sends the cue itself, not an arm
+#define GO_MAX_COPIES 3   // leaves a TX queue slot for anything else
+
+static_assert(ANTLER_CUE_MAX_LEN <= RF69_TX_QUEUE_DATA_LEN, "an encoded cue must fit a TX queue slot");
+static_assert(ANTLER_ARM_MAX_LEN <= ANTLER_CUE_MAX_LEN, "an arm frame must fit the cue buffers and history");
+static_assert(ANTLER_PROFILES == RF69_PROFILES, "hats and the driver must agree on the radio profiles");
+static_assert(FLEET_FRAME_MAX <= REPLY_FRAME_MAX && SERIAL_STATS_COUNTERS_LEN <= REPLY_FRAME_MAX &&
+              SERIAL_STATS_HISTOGRAMS_LEN <= REPLY_FRAME_MAX && AIRTIME_FRAME_MAX <= REPLY_FRAME_MAX,
+              "reply frames must fit sendFrame()");
+static_assert(SERIAL_POLL_REPLY_LEN <= REPLY_FRAME_MAX && SERIAL_FLEET_POLL_REPLY_LEN <= REPLY_FRAME_MAX,
+              "reply frames must fit sendFrame()");
+static_assert(SERIAL_AIRTIME_RECORD_LEN == NODE_AIRTIME_RECORD_LEN && NODE_AIRTIME_PERIOD_MS == RF69_AIRTIME_PERIOD_MS,
+              "SERIAL_RSP_AIRTIME must match NodeAirtime.h");
+static_assert(SERIAL_LOOP_BUCKETS == PROFILE_BUCKETS, "SERIAL_RSP_LOOP_STATS must match the profiler's histograms");
+static_assert(SERIAL_STATS_BUCKETS == RF69_STATS_BUCKETS && SERIAL_STATS_RETRIES == RF69_STATS_RETRIES,
+              "SERIAL_RSP_RADIO_STATS must match the driver's histograms");
 
 #define DEBUG_MODE  //uncomment to enable debug comments
+//#define LOOP_PROFILER //uncomment to time the sections of loop() (SERIAL_CMD_LOOP_STATS), ~200 bytes of RAM
+//#define NODE_AIRTIME  //uncomment to count each hat's airtime (SERIAL_CMD_AIRTIME), ~510 bytes of RAM
+//#define TELEMETRY_POLL //uncomment for collision free telemetry sweeps (SERIAL_CMD_POLL), ~55 bytes of RAM
+//#define FLEET_POLLER  //uncomment to ask every hat for its status (SERIAL_CMD_FLEET_POLL), ~130 bytes of RAM
 #define VERSION 1   // Version of code programmed
 
 byte currentState; // What is the current state of this module?
 
 SPIFlash flash(SS_FLASHMEM, FLASH_ID);
+ShowPlayer show(flash);
 
+// radio sends the cues; with DUAL_RADIO telemetryRadio takes the hats' telemetry on
+// ANTLER_TELEMETRY_FREQUENCY, see AntlerProtocol.h
 #ifdef ENABLE_ATC
   RFM69_ATC radio;
 #else
   RFM69 radio;
 #endif
+#ifdef DUAL_RADIO
+  #ifdef ENABLE_ATC
+    RFM69_ATC telemetryRadio(TELEMETRY_CS, TELEMETRY_IRQ);
+  #else
+    RFM69 telemetryRadio(TELEMETRY_CS, TELEMETRY_IRQ);
+  #endif
+  bool dualRadio = false; // the second radio answered in setup()
+#endif
 
-char input = 0;
+SerialFrameReader serialLink; // reassembles host command frames byte by byte
+FleetTable fleet;
+CueHistory cueHistory;
+CueBurst cueBurst;
+SyncBeacon syncBeacon;
+bool binaryOutput = false; // host selected SERIAL_OUTPUT_BINARY
+uint8_t telemetryBatch[2 + TELEMETRY_BATCH_RECORDS * SERIAL_TELEMETRY_RECORD_LEN]; // SERIAL_RSP_TELEMETRY being filled
+uint8_t telemetryCount;
+uint8_t radioStatsRadio;      // SERIAL_CMD_RADIO_STATS being answered
+bool radioStatsReset;
+uint8_t radioStatsNext = SERIAL_STATS_PARTS; // next SERIAL_RSP_RADIO_STATS part, SERIAL_STATS_PARTS when idle
+#ifdef NODE_AIRTIME
+  NodeAirtime nodeAirtime;
+#endif
+#ifdef TELEMETRY_POLL
+  TelemetryPoll telemetryPoll;
+#endif
+#ifdef FLEET_POLLER
+  FleetPoller fleetPoller;
+#endif
+#ifdef LOOP_PROFILER
+  LoopProfiler profiler;
+  uint8_t loopStatsNext = PROFILE_SECTIONS; // next SERIAL_RSP_LOOP_STATS section, PROFILE_SECTIONS when idle
+  bool loopStatsReset;
+  #define PROFILE_SCOPE(section) ProfileScope profileScope(profiler, section)
+#else
+  #define PROFILE_SCOPE(section)
+#endif
 long lastPeriod = -1;
 
 // struct for EEPROM config
@@ -68,29 +147,6 @@ struct configuration {
   byte codeversion; // What version code we're using
 } CONFIG;
 
-// struct for packets being sent to antler hats
-typedef struct {
-  byte  nodeId; // Sender node ID
-  byte  version; // What version payload
-  byte  state; // What state are we being told to go into?
-  bool  antlerState; // What state do we want the actual antlers to be in?
-  bool  antlerStateUse; // Should we pay attention to the incoming Antler state?
-  long  sleepTime; // In milliseconds. Used if we want to overwrite pre-defined states
-  bool  sleepTimeUse; // Should we pay attention to the incoming sleep time?
-} ToAntlersPayload;
-ToAntlersPayload antlersPayload;
-
-// struct for packets being sent to controllers
-typedef struct {
-  byte  nodeId; // Sender node ID
-  byte  version; // What version payload
-  byte  state; // What state Hat node is currently in
-  bool  antlerState; // What state the antlers are currently in
-  float vcc; // VCC read from battery monitor
-  int   temperature; // Temperature of the radio
-} ToControllersPayload;
-ToControllersPayload controllersPayload;
-
   void Blink(byte PIN, byte DELAY_MS, byte loops)
 {
   for (byte i=0; i<loops; i++)
@@ -129,27 +185,38 @@ void setup() {
   radio.setHighPower(); //must include this only for RFM69HW/HCW!
 #endif
 
-  Serial.print("Start node ");
+#ifdef DUAL_RADIO
+  // Without the second radio fitted the controller runs on one, as hats only move
+  // their telemetry once beacons tell them to
+  dualRadio = telemetryRadio.initialize(FREQUENCY,NODEID,NETWORKID);
+  if (dualRadio) {
+    telemetryRadio.encrypt(ENCRYPTKEY);
+    telemetryRadio.setFrequency(ANTLER_TELEMETRY_FREQUENCY);
+  #ifdef IS_RFM69HW_HCW
+    telemetryRadio.setHighPower(); // only ever sends ACKs, but the PA setting must match the module
+  #endif
+    syncBeacon.telemetryChannel(true);
+    Serial.print(F("Telemetry radio at "));
+    Serial.println(ANTLER_TELEMETRY_FREQUENCY);
+  }
+  else Serial.println(F("No telemetry radio, telemetry shares the cue channel"));
+#endif
+
+  Serial.print(F("Start node "));
   Serial.println(NODEID);
 
   if (flash.initialize())
-    Serial.println("SPI Flash Init OK!");
+    Serial.println(F("SPI Flash Init OK!"));
   else
-    Serial.println("SPI Flash Init FAIL!");
+    Serial.println(F("SPI Flash Init FAIL!"));
 
-  Serial.println("Listening at 915 Mhz...");
+  Serial.println(F("Listening at 915 Mhz..."));
   Serial.println(FREQUENCY_EXACT);
   Serial.println(NETWORKID);
   Serial.println(ENCRYPTKEY);
 
 #ifdef BR_300KBPS
-  radio.writeReg(0x03, 0x00);  //REG_BITRATEMSB: 300kbps (0x006B, see DS p20)
-  radio.writeReg(0x04, 0x6B);  //REG_BITRATELSB: 300kbps (0x006B, see DS p20)
-  radio.writeReg(0x19, 0x40);  //REG_RXBW: 500kHz
-  radio.writeReg(0x1A, 0x80);  //REG_AFCBW: 500kHz
-  radio.writeReg(0x05, 0x13);  //REG_FDEVMSB: 300khz (0x1333)
-  radio.writeReg(0x06, 0x33);  //REG_FDEVLSB: 300khz (0x1333)
-  radio.writeReg(0x29, 240);   //set REG_RSSITHRESH to -120dBm
+  radio.setProfile(RF69_PROFILE_300KBPS); // hats start on the default profile and hunt for this one
 #endif
 }
 
@@ -171,8 +238,101 @@ void blinkLED(int blinkTime, int blinkNumber)
   // }
 }
 
-void sendAntlerPayload(byte hatState, bool antlerState, bool antlerStateUse, long sleepTime, bool sleepTimeUse, byte node = 0)
+// Queue whatever burst copies have come due
+void sendBurstCopies()
+{
+  uint8_t frame[ANTLER_CUE_MAX_LEN];
+  uint8_t node, len;
+  while ((len = cueBurst.due(frame, node)) != 0) {
+    if (!radio.sendAsync(node, frame, len, false) && !binaryOutput)
+      Serial.println(F("TX queue full, burst copy dropped"));
+  }
+}
+
+// Queue a time sync beacon or a telemetry poll when one is due. Both are stamped, so
+// only with the TX queue empty: the stamp read just before is then known to be the
+// previous one's, and the queue being empty without a stamp means it never went out.
+// Polls go on the cue radio, where every hat listens; both radios share the profile
+// the slots are sized for.
+void sendStampedFrame()
+{
+  uint32_t txMicros;
+  bool stamped = radio.txStamp(txMicros);
+#ifdef TELEMETRY_POLL
+  if (telemetryPoll.queued()) {
+    if (stamped) telemetryPoll.sent(txMicros);
+    else if (!radio.txQueued()) telemetryPoll.lost();
+    stamped = false; // the poll's, not a beacon's
+  }
+#endif
+  if (stamped) syncBeacon.sent(txMicros);
+  if (radio.txQueued()) return;
+  uint8_t frame[STAMPED_FRAME_MAX];
+  uint8_t len = syncBeacon.due(frame);
+  if (len) {
+    radio.sendAsync(BROADCASTID, frame, len, false, true);
+    return;
+  }
+#ifdef TELEMETRY_POLL
+  len = telemetryPoll.due(frame, radio.airtimeUs(ANTLER_TELEMETRY_LEN) + ANTLER_POLL_GUARD_US);
+  if (len && !radio.sendAsync(BROADCASTID, frame, len, false, true)) telemetryPoll.lost();
+#endif
+}
+
+#ifdef FLEET_POLLER
+// Send the next status request of a fleet poll. Only with the TX queue empty, so sync
+// beacons and telemetry polls still find it empty and each request's timeout starts
+// about when it goes out; the replies are what is pipelined. None during a telemetry
+// sweep, which has the channel to itself.
+void sendStatusRequests()
+{
+  fleetPoller.tick();
+#ifdef TELEMETRY_POLL
+  if (telemetryPoll.queued() || telemetryPoll.sweeping()) return;
+#endif
+  uint8_t frame[ANTLER_STATUS_LEN];
+  uint8_t node;
+  if (radio.txQueued() == 0 && fleetPoller.next(node))
+    radio.sendAsync(node, frame, antlerEncodeStatus(frame), false);
+}
+#endif
+
+#ifdef TELEMETRY_POLL
+// With one radio a sweep's slots are on the cue channel, so nothing else goes out until
+// they are over; cues wait up to a sweep. A second radio takes the answers elsewhere.
+void holdForSweep()
 {
+#ifdef DUAL_RADIO
+  if (dualRadio) return;
+#endif
+  radio.txHold(telemetryPoll.sweeping());
+}
+#endif
+
+// Move the radio to an announced profile once its time has come. The driver refuses
+// while a frame is on the air, so this just tries again next loop()
+void switchProfile()
+{
+  uint8_t profile;
+  if (!syncBeacon.switchDue(profile)) return;
+#ifdef DUAL_RADIO
+  if (dualRadio && !telemetryRadio.setProfile(profile)) return; // setting it again next time is harmless
+#endif
+  if (!radio.setProfile(profile)) return;
+  syncBeacon.switched();
+  if (!binaryOutput) {
+    Serial.print(F("Radio profile ")); Serial.println(profile);
+  }
+}
+
+// node 0 broadcasts; a group cue is always broadcast and only that group's hats act on it.
+// Broadcasts are scheduled on network time so synced hats act together, see SyncBeacon.h.
+// A broadcast burst goes out as cueBurst.copies copies, see CueBurst.h.
+// With armSlot the cue is only armed on the hats, sendGo() fires it (see ANTLER_MSG_ARM).
+void sendAntlerPayload(byte hatState, bool antlerState, bool antlerStateUse, long sleepTime, bool sleepTimeUse, byte node = 0, byte group = 0, bool burst = false, byte armSlot = ARM_NONE)
+{
+  PROFILE_SCOPE(PROFILE_PAYLOAD);
+  ToAntlersPayload antlersPayload;
   antlersPayload.nodeId = NODEID;
   antlersPayload.version = VERSION;
   antlersPayload.state = hatState;
@@ -180,6 +340,16 @@ void sendAntlerPayload(byte hatState, bool antlerState, bool antlerStateUse, lon
   antlersPayload.antlerStateUse = antlerStateUse;
   antlersPayload.sleepTime = sleepTime;
   antlersPayload.sleepTimeUse = sleepTimeUse;
+  antlersPayload.group = group;
+  antlersPayload.seqUse = false;
+  antlersPayload.copiesLeft = 0;
+  antlersPayload.fireInMs = 0;
+  antlersPayload.atUse = false;
+  if (group) node = BROADCASTID;
+  if (node == BROADCASTID) {
+    cueHistory.number(antlersPayload);
+    syncBeacon.schedule(antlersPayload);
+  }
 
 //  if (radio.send(255, (const void*)(&antlersPayload), sizeof(antlersPayload), false))
 //    Serial.println("Sent payload");
@@ -188,7 +358,21 @@ void sendAntlerPayload(byte hatState, bool antlerState, bool antlerStateUse, lon
   //radio.send(255, (const void*)(&antlersPayload), sizeof(antlersPayload), false);
   //  antlersPayload.nodeId = NODEID;
   
-  radio.send(node, (const void*)(&antlersPayload), sizeof(antlersPayload), false);
+  // queued, receiveDone() in loop() sends it once the channel is clear
+  uint8_t frame[ANTLER_CUE_MAX_LEN];
+  if (armSlot == ARM_NONE && burst && node == BROADCASTID && cueBurst.start(antlersPayload, node)) {
+    // start() moved atMicros to the burst's fire time; repairs go out as plain cues
+    cueHistory.add(antlersPayload.seq, frame, antlerEncodeCue(antlersPayload, frame));
+    sendBurstCopies();
+  }
+  else {
+    uint8_t len = armSlot == ARM_NONE ? antlerEncodeCue(antlersPayload, frame) : antlerEncodeArm(armSlot, antlersPayload, frame);
+    if (radio.sendAsync(node, frame, len, false)) {
+      if (antlersPayload.seqUse) cueHistory.add(antlersPayload.seq, frame, len);
+    }
+    else if (!binaryOutput)
+      Serial.println(F("TX queue full, cue dropped"));
+  }
     //Serial.println("Send succeeded");
   //else Serial.println("Send failed");
 
@@ -202,6 +386,7 @@ void sendAntlerPayload(byte hatState, bool antlerState, bool antlerStateUse, lon
   // else {
   //   Serial.println("Send failed");
   // }
+  if (binaryOutput) return;
   Serial.println(antlersPayload.version);
   Serial.println(antlersPayload.state);
   Serial.println(antlersPayload.antlerState);
@@ -211,66 +396,480 @@ void sendAntlerPayload(byte hatState, bool antlerState, bool antlerStateUse, lon
 }
 
 
+//*************************************
+// Serial commands                    *
+//*************************************
+
+// Send one cue body: node(1) state(1) flags(1) sleepTime(4), as used by SERIAL_CMD_CUE and show records,
+// or arm it in armSlot for SERIAL_CMD_ARM
+void sendCue(const uint8_t* cue, byte armSlot = ARM_NONE)
+{
+  if (!binaryOutput) {
+    if (armSlot == ARM_NONE) Serial.print(F("\nSending state "));
+    else { Serial.print(F("\nArming slot ")); Serial.print(armSlot); Serial.print(F(" with state ")); }
+    Serial.println(cue[1]);
+  }
+  bool group = cue[2] & SERIAL_CUE_GROUP;
+  sendAntlerPayload(cue[1], cue[2] & SERIAL_CUE_ANTLERSTATE, cue[2] & SERIAL_CUE_ANTLERSTATEUSE,
+                    (long)serialGetLong(&cue[3]), cue[2] & SERIAL_CUE_SLEEPTIMEUSE,
+                    group ? BROADCASTID : cue[0], group ? cue[0] : 0, cue[2] & SERIAL_CUE_BURST, armSlot);
+}
+
+// Fire the cues armed in slot on every hat, see ANTLER_MSG_GO
+void sendGo(byte slot, byte copies)
+{
+  uint8_t frame[ANTLER_GO_LEN];
+  uint8_t len = antlerEncodeGo(slot, frame);
+  for (byte i = 0; i < copies; i++) {
+    if (!radio.sendAsync(BROADCASTID, frame, len, false)) {
+      if (!binaryOutput) Serial.println(F("TX queue full, GO dropped"));
+      break;
+    }
+  }
+}
+
+// Re-send the broadcast cues a hat's telemetry says it missed, to that hat only
+void repairCues(const ToControllersPayload& telemetry)
+{
+  const uint8_t* frame;
+  uint8_t len;
+  for (uint8_t i = cueHistory.nextMissing(telemetry, 0, frame, len); i != 0; i = cueHistory.nextMissing(telemetry, i, frame, len)) {
+    if (!radio.sendAsync(telemetry.nodeId, frame, len, false)) break; // the next report will ask again
+  }
+}
+
+// Push a hat's group membership, see ANTLER_MSG_GROUPS
+void sendGroups(byte node, uint16_t groups)
+{
+  uint8_t frame[ANTLER_GROUPS_LEN];
+  if (!radio.sendAsync(node, frame, antlerEncodeGroups(groups, frame), false) && !binaryOutput)
+    Serial.println(F("TX queue full, groups dropped"));
+}
+
+// Push a hat's assigned poll slot, see ANTLER_MSG_SLOT
+void sendSlot(byte node, byte slot)
+{
+  uint8_t frame[ANTLER_SLOT_LEN];
+  if (!radio.sendAsync(node, frame, antlerEncodeSlot(slot, frame), false) && !binaryOutput)
+    Serial.println(F("TX queue full, slot dropped"));
+}
+
+// Radio n of SERIAL_CMD_RADIO_STATS, NULL if there is no such radio
+RFM69* statsRadio(byte n)
+{
+  if (n == 0) return &radio;
+#ifdef DUAL_RADIO
+  if (n == 1 && dualRadio) return &telemetryRadio;
+#endif
+  return NULL;
+}
+
+// Act on one decoded frame from the host, see SerialLink.h for the layouts
+void handleSerialFrame(const uint8_t* frame, uint8_t len)
+{
+  switch (frame[0]) {
+    case SERIAL_CMD_CUE:
+      if (len == SERIAL_CUE_LEN) sendCue(&frame[1]);
+      break;
+    case SERIAL_CMD_SHOW_ERASE:
+      show.erase();
+      Serial.println(F("Show erased"));
+      break;
+    case SERIAL_CMD_SHOW_CUE:
+      if (len != SERIAL_SHOW_CUE_LEN || !show.store(serialGetShort(&frame[1]), &frame[3]))
+        Serial.println(F("Show cue rejected"));
+      break;
+    case SERIAL_CMD_SHOW_COMMIT:
+      if (len == SERIAL_SHOW_COMMIT_LEN && show.commit(serialGetShort(&frame[1]))) {
+        Serial.print(F("Show stored, cues: ")); Serial.println(show.count());
+      }
+      else Serial.println(F("Show commit rejected"));
+      break;
+    case SERIAL_CMD_SHOW_START:
+      if (len == SERIAL_SHOW_START_LEN && show.start(serialGetLong(&frame[1]))) {
+        Serial.print(F("Show started at cue ")); Serial.println(show.position());
+      }
+      else Serial.println(F("No show stored"));
+      break;
+    case SERIAL_CMD_SHOW_STOP:
+      show.stop();
+      Serial.print(F("Show stopped at cue ")); Serial.println(show.position());
+      break;
+    case SERIAL_CMD_FLEET_DUMP:
+      if (len == SERIAL_FLEET_DUMP_LEN) fleet.startDump(frame[1] & SERIAL_FLEET_CHANGED);
+      break;
+    case SERIAL_CMD_GROUPS:
+      if (len == SERIAL_GROUPS_LEN && frame[1] != BROADCASTID) sendGroups(frame[1], serialGetShort(&frame[2]));
+      break;
+    case SERIAL_CMD_BURST:
+      if (len != SERIAL_BURST_LEN || !cueBurst.configure(frame[1], frame[2]))
+        Serial.println(F("Burst setting rejected"));
+      break;
+    case SERIAL_CMD_ARM:
+      if (len == SERIAL_ARM_LEN && frame[1] < ANTLER_ARM_SLOTS) sendCue(&frame[2], frame[1]);
+      else Serial.println(F("Arm rejected"));
+      break;
+    case SERIAL_CMD_GO:
+      if (len == SERIAL_GO_LEN && frame[1] < ANTLER_ARM_SLOTS && frame[2] >= 1 && frame[2] <= GO_MAX_COPIES)
+        sendGo(frame[1], frame[2]);
+      break;
+    case SERIAL_CMD_PROFILE:
+      if (len != SERIAL_PROFILE_LEN || !syncBeacon.announceSwitch(frame[1], serialGetShort(&frame[2])))
+        Serial.println(F("Profile switch rejected"));
+      break;
+    case SERIAL_CMD_OUTPUT:
+      if (len == SERIAL_OUTPUT_LEN) binaryOutput = frame[1] == SERIAL_OUTPUT_BINARY;
+      break;
+    case SERIAL_CMD_LOOP_STATS:
+#ifdef LOOP_PROFILER
+      if (len == SERIAL_LOOP_STATS_LEN) {
+        loopStatsReset = frame[1] & SERIAL_STATS_RESET;
+        loopStatsNext = 0;
+        break;
+      }
+#endif
+      Serial.println(F("Loop stats rejected"));
+      break;
+    case SERIAL_CMD_AIRTIME:
+#ifdef NODE_AIRTIME
+      if (len == SERIAL_AIRTIME_LEN) {
+        nodeAirtime.startDump();
+        break;
+      }
+#endif
+      Serial.println(F("Airtime rejected"));
+      break;
+    case SERIAL_CMD_POLL:
+#ifdef TELEMETRY_POLL
+      if (len == SERIAL_POLL_LEN && telemetryPoll.configure(frame[1], frame[2], frame[3] & SERIAL_POLL_ASSIGNED, serialGetShort(&frame[4])))
+        break;
+#endif
+      Serial.println(F("Poll setting rejected"));
+      break;
+    case SERIAL_CMD_SLOT:
+      if (len == SERIAL_SLOT_LEN && frame[1] != BROADCASTID) sendSlot(frame[1], frame[2]);
+      break;
+    case SERIAL_CMD_FLEET_POLL:
+#ifdef FLEET_POLLER
+      if (len == SERIAL_FLEET_POLL_LEN &&
+          fleetPoller.configure(frame[1], frame[2], frame[3], frame[4], serialGetShort(&frame[5])))
+        break;
+#endif
+      Serial.println(F("Fleet poll setting rejected"));
+      break;
+    case SERIAL_CMD_RADIO_STATS: {
+      if (len != SERIAL_RADIO_STATS_LEN || statsRadio(frame[1]) == NULL) {
+        Serial.println(F("Radio stats rejected"));
+        break;
+      }
+      radioStatsRadio = frame[1]; // sendRadioStats() reads each part as it goes out
+      radioStatsReset = frame[2] & SERIAL_STATS_RESET;
+      radioStatsNext = 0;
+      break;
+    }
+  }
+}
+
+// True when a reply frame of len (type + body) fits in the serial TX buffer right now
+bool canSendFrame(uint8_t len)
+{
+  return Serial.availableForWrite() >= len + 5; // CRC, COBS code, two delimiters
+}
+
+// Write one reply frame. The leading delimiter ends any text the host has half read.
+void sendFrame(const uint8_t* frame, uint8_t len)
+{
+  uint8_t encoded[REPLY_FRAME_MAX + 4];
+  Serial.write((uint8_t)SERIAL_FRAME_DELIM);
+  Serial.write(encoded, serialFrameEncode(frame, len, encoded));
+}
+
+// Send the next SERIAL_RSP_FLEET frames of a requested dump, only as many as fit in the
+// serial TX buffer so a full dump never stalls the radio
+void sendFleetFrames()
+{
+  uint8_t frame[FLEET_FRAME_MAX];
+  while (fleet.dumping() && canSendFrame(sizeof(frame))) {
+    uint8_t count;
+    bool more = fleet.nextRecords(&frame[2], FLEET_FRAME_RECORDS, count);
+    frame[0] = SERIAL_RSP_FLEET;
+    frame[1] = more ? 0 : SERIAL_FLEET_LAST | (fleet.untracked() ? SERIAL_FLEET_UNTRACKED : 0);
+    sendFrame(frame, 2 + count * FLEET_RECORD_LEN);
+  }
+}
+
+// Send the parts of a SERIAL_CMD_RADIO_STATS reply, each read from the driver once it
+// fits in the serial TX buffer; a reset waits for the last part
+void sendRadioStats()
+{
+  while (radioStatsNext < SERIAL_STATS_PARTS) {
+    bool counters = radioStatsNext == SERIAL_STATS_COUNTERS;
+    if (!canSendFrame(counters ? SERIAL_STATS_COUNTERS_LEN : SERIAL_STATS_HISTOGRAMS_LEN)) return;
+    RFM69* rx = statsRadio(radioStatsRadio);
+    RFM69Stats stats;
+    rx->readStats(stats, radioStatsReset && radioStatsNext + 1 == SERIAL_STATS_PARTS);
+    uint8_t frame[REPLY_FRAME_MAX];
+    frame[0] = SERIAL_RSP_RADIO_STATS;
+    frame[1] = radioStatsRadio;
+    frame[2] = radioStatsNext;
+    uint8_t len = 3;
+    if (counters) {
+      uint32_t lastTx, lastRx;
+      rx->lastAirtime(lastTx, lastRx);
+      frame[len++] = rx->getPowerLevel();
+      serialPutLong(&frame[len], stats.framesSent); len += 4;
+      serialPutLong(&frame[len], stats.framesReceived); len += 4;
+      const uint16_t counts[] = { stats.addressFiltered, stats.badFrames, stats.rxDropped, stats.rxRestarts,
+                                  stats.csmaTimeouts, stats.txTimeouts, stats.retryFailures, stats.csmaBusy };
+      for (uint8_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++, len += 2) serialPutShort(&frame[len], counts[i]);
+      const uint32_t airtimes[] = { stats.txAirtimeUs, stats.rxAirtimeUs, lastTx, lastRx };
+      for (uint8_t i = 0; i < sizeof(airtimes) / sizeof(airtimes[0]); i++, len += 4) serialPutLong(&frame[len], airtimes[i]);
+    }
+    else {
+      for (uint8_t i = 0; i < RF69_STATS_BUCKETS; i++, len += 2) serialPutShort(&frame[len], stats.csmaWait[i]);
+      for (uint8_t i = 0; i < RF69_STATS_BUCKETS; i++, len += 2) serialPutShort(&frame[len], stats.ackRtt[i]);
+      for (uint8_t i = 0; i < RF69_STATS_RETRIES; i++, len += 2) serialPutShort(&frame[len], stats.retries[i]);
+    }
+    sendFrame(frame, len);
+    radioStatsNext++;
+  }
+}
+
+#ifdef TELEMETRY_POLL
+// Report a finished sweep, as a SERIAL_RSP_POLL frame once it fits or as a text line
+void sendPollResult()
+{
+  if (binaryOutput && !canSendFrame(SERIAL_POLL_REPLY_LEN)) return;
+  uint8_t slots, answered;
+  uint32_t sweepUs;
+  if (!telemetryPoll.finished(slots, answered, sweepUs)) return;
+  if (binaryOutput) {
+    uint8_t frame[SERIAL_POLL_REPLY_LEN];
+    frame[0] = SERIAL_RSP_POLL;
+    frame[1] = slots;
+    frame[2] = answered;
+    serialPutLong(&frame[3], sweepUs);
+    sendFrame(frame, sizeof(frame));
+    return;
+  }
+  Serial.print(F("Sweep answered ")); Serial.print(answered);
+  Serial.print('/'); Serial.print(slots);
+  Serial.print(F(" in ")); Serial.print(sweepUs); Serial.println(F("us"));
+}
+#endif
+
+#ifdef FLEET_POLLER
+// Report a finished fleet poll sweep, like sendPollResult()
+void sendFleetPollResult()
+{
+  if (binaryOutput && !canSendFrame(SERIAL_FLEET_POLL_REPLY_LEN)) return;
+  uint8_t nodes, answered;
+  uint16_t timeouts;
+  uint32_t sweepUs;
+  if (!fleetPoller.finished(nodes, answered, timeouts, sweepUs)) return;
+  if (binaryOutput) {
+    uint8_t frame[SERIAL_FLEET_POLL_REPLY_LEN];
+    frame[0] = SERIAL_RSP_FLEET_POLL;
+    frame[1] = nodes;
+    frame[2] = answered;
+    serialPutShort(&frame[3], timeouts);
+    serialPutLong(&frame[5], sweepUs);
+    sendFrame(frame, sizeof(frame));
+    return;
+  }
+  Serial.print(F("Fleet poll answered ")); Serial.print(answered);
+  Serial.print('/'); Serial.print(nodes);
+  Serial.print(F(", ")); Serial.print(timeouts);
+  Serial.print(F(" timeouts, in ")); Serial.print(sweepUs); Serial.println(F("us"));
+}
+#endif
+
+#ifdef NODE_AIRTIME
+// Send the next SERIAL_RSP_AIRTIME frames of a requested dump, like sendFleetFrames()
+void sendAirtimeFrames()
+{
+  uint8_t frame[AIRTIME_FRAME_MAX];
+  while (nodeAirtime.dumping() && canSendFrame(sizeof(frame))) {
+    uint8_t count;
+    bool more = nodeAirtime.nextRecords(&frame[2], AIRTIME_FRAME_RECORDS, count);
+    frame[0] = SERIAL_RSP_AIRTIME;
+    frame[1] = more ? 0 : SERIAL_FLEET_LAST;
+    sendFrame(frame, 2 + count * NODE_AIRTIME_RECORD_LEN);
+  }
+}
+#endif
+
+#ifdef LOOP_PROFILER
+// Send the SERIAL_RSP_LOOP_STATS sections, each once it fits in the serial TX buffer
+void sendLoopStats()
+{
+  uint8_t frame[SERIAL_LOOP_SECTION_LEN];
+  while (loopStatsNext < PROFILE_SECTIONS && canSendFrame(sizeof(frame))) {
+    uint8_t section = loopStatsNext++;
+    frame[0] = SERIAL_RSP_LOOP_STATS;
+    frame[1] = section;
+    serialPutLong(&frame[2], profiler.count(section));
+    serialPutLong(&frame[6], profiler.maxUs(section));
+    serialPutLong(&frame[10], profiler.p99Us(section));
+    for (uint8_t i = 0; i < PROFILE_BUCKETS; i++) serialPutShort(&frame[14 + 2 * i], profiler.bucket(section, i));
+    sendFrame(frame, sizeof(frame));
+    if (loopStatsReset) profiler.reset(section);
+  }
+}
+#endif
+
+// Add one packet to the SERIAL_RSP_TELEMETRY batch, or count it as dropped if the batch is full
+void queueTelemetry(const ToControllersPayload& payload, int16_t rssi)
+{
+  if (telemetryCount == TELEMETRY_BATCH_RECORDS) {
+    if (telemetryBatch[1] < 255) telemetryBatch[1]++;
+    return;
+  }
+  uint8_t* record = &telemetryBatch[2 + telemetryCount++ * SERIAL_TELEMETRY_RECORD_LEN];
+  record[0] = payload.nodeId;
+  record[1] = payload.version;
+  record[2] = payload.state;
+  record[3] = payload.antlerState ? SERIAL_TELEMETRY_ANTLERSTATE : 0;
+  serialPutShort(&record[4], payload.vcc > 0 ? payload.vcc * 1000 + 0.5f : 0);
+  record[6] = constrain(payload.temperature, -128, 127);
+  record[7] = constrain(rssi, -128, 127);
+}
+
+// Send the batch as a single write, once per loop() and only when it won't block
+void sendTelemetry()
+{
+  uint8_t len = 2 + telemetryCount * SERIAL_TELEMETRY_RECORD_LEN;
+  if ((telemetryCount == 0 && telemetryBatch[1] == 0) || !canSendFrame(len)) return;
+  telemetryBatch[0] = SERIAL_RSP_TELEMETRY;
+  sendFrame(telemetryBatch, len);
+  telemetryCount = 0;
+  telemetryBatch[1] = 0;
+}
+
+// Handle the frame rx.receiveDone() just reported. Repairs always go out on the cue radio.
+void receiveFrame(RFM69& rx)
+{
+  PROFILE_SCOPE(PROFILE_RECEIVE);
+#ifdef NODE_AIRTIME
+  nodeAirtime.add(rx.SENDERID, rx.airtimeUs(rx.DATALEN));
+#endif
+  if (rx.ACKRequested()) {
+    rx.sendACK();
+    #ifdef DEBUG_MODE
+      if (!binaryOutput) Serial.print(F(" - ACK sent"));
+    #endif
+  }
+  
+  // Check for a new OTA sketch. If so, update will be applied and unit restarted.
+  {
+    PROFILE_SCOPE(PROFILE_OTA);
+    CheckForWirelessHEX(rx, flash, false);
+  }
+
+ #ifdef DEBUG_MODE
+  if (!binaryOutput) {
+    Serial.print(F("Got ["));
+    Serial.print(rx.SENDERID);
+    Serial.print(':');
+    Serial.print(rx.DATALEN);
+    Serial.print(F("] > "));
+    for (byte i = 0; i < rx.DATALEN; i++)
+      Serial.print((char)rx.DATA[i], HEX);
+    Serial.println();
+  }
+  #endif
+
+  // Check if valid packet: anything but current version telemetry (OTA frames, old hats) is skipped
+  ToControllersPayload controllersPayload;
+  if (!antlerDecodeTelemetry(rx.DATA, rx.DATALEN, rx.SENDERID, controllersPayload)) {
+    #ifdef DEBUG_MODE
+      if (!binaryOutput) Serial.println(F("Invalid payload received, not matching telemetry version"));
+    #endif
+  }
+  else
+  {
+    if (!fleet.update(controllersPayload, rx.RSSI) && !binaryOutput) {
+      Serial.print(F("Node ")); Serial.print(controllersPayload.nodeId); Serial.println(F(" beyond the fleet table"));
+    }
+#ifdef TELEMETRY_POLL
+    telemetryPoll.heard(controllersPayload.nodeId);
+#endif
+#ifdef FLEET_POLLER
+    fleetPoller.heard(controllersPayload.nodeId);
+#endif
+    repairCues(controllersPayload);
+
+    //Send the data straight out the serial, as text or as fixed size binary records (SERIAL_CMD_OUTPUT)
+    if (binaryOutput) queueTelemetry(controllersPayload, rx.RSSI);
+    else {
+      Serial.print(F("ID:"));Serial.println(controllersPayload.nodeId);      // Node ID
+      Serial.print(F("VS:"));Serial.println(controllersPayload.version);     // Payload version
+      Serial.print(F("ST:"));Serial.println(controllersPayload.state);       // Node state
+      Serial.print(F("AS:"));Serial.println(controllersPayload.antlerState); // Antler state
+      Serial.print(F("VC:"));Serial.println(controllersPayload.vcc);         // Battery voltage
+      Serial.print(F("TP:"));Serial.println(controllersPayload.temperature); // Radio temperature
+    }
+  
+  } // close valid payload
+}
+
 //*************************************
 // Loop                               *
 //*************************************
 
 void loop(){
+#ifdef LOOP_PROFILER
+    static uint32_t loopStart;
+    uint32_t now = micros();
+    if (loopStart) profiler.record(PROFILE_LOOP, now - loopStart);
+    loopStart = now;
+#endif
+
+    // Fire whatever show cues have come due
+    const uint8_t* record;
+    while ((record = show.due()) != NULL)
+      sendCue(&record[4]);
 
-    // Handle serial input
+    // Handle serial input: take whatever bytes have arrived, never wait for more
     if (Serial.available() > 0) {
-      input = Serial.parseInt();
-      //int intInput = input - '0'
-
-      if (input >= 1 && input <= 9) { //0-9
-        Serial.print("\nSending state "); Serial.println(input);
-        sendAntlerPayload((byte)input, 0, 0, 0, 0);
-      } 
-    }  // close if Serial.available()
+      PROFILE_SCOPE(PROFILE_SERIAL);
+      while (Serial.available() > 0) {
+        if (serialLink.feed(Serial.read()))
+          handleSerialFrame(serialLink.frame(), serialLink.length());
+      }
+    }
+    sendBurstCopies();
+    switchProfile();
+    sendStampedFrame();
+#ifdef TELEMETRY_POLL
+    holdForSweep();
+#endif
+#ifdef FLEET_POLLER
+    sendStatusRequests();
+#endif
+    sendFleetFrames();
+    sendRadioStats();
+#ifdef TELEMETRY_POLL
+    sendPollResult();
+#endif
+#ifdef FLEET_POLLER
+    sendFleetPollResult();
+#endif
+#ifdef LOOP_PROFILER
+    sendLoopStats();
+#endif
+#ifdef NODE_AIRTIME
+    sendAirtimeFrames();
+    nodeAirtime.tick();
+#endif
+    fleet.tick();
   
   // Check for existing RF data
-  if (radio.receiveDone()) {
-
-    if (radio.ACKRequested()) {
-      radio.sendACK();
-      #ifdef DEBUG_MODE
-        Serial.print(" - ACK sent");
-      #endif
-    }
-    
-    // Check for a new OTA sketch. If so, update will be applied and unit restarted.
-    CheckForWirelessHEX(radio, flash, false);
-
-   #ifdef DEBUG_MODE
-      Serial.print("Got [");
-      Serial.print(radio.SENDERID);
-      Serial.print(':');
-      Serial.print(radio.DATALEN);
-      Serial.print("] > ");
-      for (byte i = 0; i < radio.DATALEN; i++)
-        Serial.print((char)radio.DATA[i], HEX);
-      Serial.println();
-    #endif
+  if (radio.receiveDone()) receiveFrame(radio);
+#ifdef DUAL_RADIO
+  if (dualRadio && telemetryRadio.receiveDone()) receiveFrame(telemetryRadio);
+#endif
 
-    // Check if valid packet. In future perhaps add checking for different payload versions
-//    if (radio.DATALEN != sizeof(ToControllersPayload)) {
-//      #ifdef DEBUG_MODE
-//        Serial.print("Invalid payload received, not matching Payload struct!");
-//      #endif
-//    }
-//    else
-//    {
-      controllersPayload = *(ToControllersPayload*)radio.DATA; // We'll hope radio.DATA actually contains our struct and not something else
-
-      //Send the data straight out the serial, we don't actually need to do anything with it internally
-      Serial.print("ID:");Serial.println(controllersPayload.nodeId);      // Node ID
-      Serial.print("VS:");Serial.println(controllersPayload.version);     // Payload version
-      Serial.print("ST:");Serial.println(controllersPayload.state);       // Node state
-      Serial.print("AS:");Serial.println(controllersPayload.antlerState); // Antler state
-      Serial.print("VC:");Serial.println(controllersPayload.vcc);         // Battery voltage
-      Serial.print("TP:");Serial.println(controllersPayload.temperature); // Radio temperature
-    
-    //} // close valid payload
-  } // close radio.receiveDone()
+  sendTelemetry();
 } // close loop()
 